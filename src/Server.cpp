@@ -1,30 +1,87 @@
+#include "./include/config.h"
 #include "./include/handle_command.h"
+#include "./include/io_threads.h"
 #include "./include/resp_parser.h"
 
 // Provides definitions for internet operations, like converting between host and
 // network byte order (e.g., htons).
 #include <arpa/inet.h>
+// Standard algorithms (e.g., std::max).
+#include <algorithm>
+// Error numbers reported by system calls (e.g., EINTR).
+#include <cerrno>
+// Durations for backing off after persistent poll()/accept() errors.
+#include <chrono>
 // C standard library. Provides general utilities like program termination
 // (e.g., EXIT_SUCCESS).
 #include <cstdlib>
+// strerror() for logging failed system calls.
+#include <cstring>
+// open() for the spare descriptor reserved for refusing connections.
+#include <fcntl.h>
+// Smart pointers (e.g., std::unique_ptr) for the optional I/O thread server.
+#include <memory>
 // C++ standard library for input/output streams (e.g., std::cout, std::cerr).
 #include <iostream>
+// Defines TCP-level socket options such as TCP_NODELAY and TCP_KEEPIDLE.
+#include <netinet/tcp.h>
+// poll() lets one thread wait on every listening socket at once.
+#include <poll.h>
 // Part of the C++ I/O library, provides ostream and related functionality like
 // std::unitbuf.
 #include <ostream>
 // Core Berkeley sockets API. Defines functions like socket(), bind(), listen(),
 // and accept() for network communication.
 #include <sys/socket.h>
+// chmod() for the Unix socket permissions.
+#include <sys/stat.h>
 // Defines various data types used in system calls, often required by other
 // system headers like <sys/socket.h>.
 #include <sys/types.h>
+// Unix domain socket addresses (struct sockaddr_un).
+#include <sys/un.h>
 // C++ standard library for creating and managing threads (e.g., std::thread).
 #include <thread>
 // POSIX standard header. Provides access to the OS API, including functions
 // like read(), write(), and close().
 #include <unistd.h>
 
-void handleClient(int client_fd) {
+// Pending replies past this size are sent before the rest of the batch runs.
+constexpr size_t kReplyFlushBytes = 64 * 1024;
+
+// Sends `reply` without blocking indefinitely. Bytes the kernel has not
+// taken yet are the client's output buffer: a client that stops reading
+// keeps it up, so the hard limit and the soft limit's grace period (checked
+// at least once a second) apply as they do in io-threads mode. Returns false
+// if the connection must be closed.
+bool sendReply(int client_fd, const std::string &reply, ClientInfo &info) {
+  size_t sent = 0;
+  while (true) {
+    size_t pending = reply.size() - sent;
+    info.output_buffer = pending;
+    if (client_registry.outputBufferExceeded(info, pending)) {
+      std::cerr << "Closing client id=" << info.id
+                << ": output buffer limit reached\n";
+      return false;
+    }
+    if (pending == 0) {
+      return true;
+    }
+
+    ssize_t n = send(client_fd, reply.data() + sent, pending,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n > 0) {
+      sent += static_cast<size_t>(n);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd pfd = {client_fd, POLLOUT, 0};
+      poll(&pfd, 1, 1000);
+    } else if (!(n < 0 && errno == EINTR)) {
+      return false; // Client went away.
+    }
+  }
+}
+
+void handleClient(int client_fd, std::shared_ptr<ClientInfo> info) {
   // This function is executed by a new thread for each client connection.
   // The `main` function creates a `std::thread` and runs this function on it.
   // This allows the server to handle multiple clients concurrently.
@@ -45,7 +102,10 @@ void handleClient(int client_fd) {
   // shared (e.g., global or passed by reference) among multiple threads.
   std::mutex input_mutex;
   std::string input;
-  char buffer[1024];
+  // Per-connection MULTI/EXEC/WATCH state; lives as long as this thread.
+  ClientState client;
+  client.info = info;
+  char buffer[16 * 1024];
 
   while (true) {
     ssize_t bytes_received = read(client_fd, buffer, sizeof(buffer));
@@ -68,96 +128,369 @@ void handleClient(int client_fd) {
       // recommended way to handle mutexes, as it guarantees the lock is
       // released even if an exception occurs.
 
-    // This inner loop processes the accumulated data from the `input` buffer.
-    while (!input.empty()) {
-      try {
-        RESPParser parser(input);
-        auto root = parser.parser();
-        if (!root) {
-          // Not enough data to parse a full command, wait for more.
-          break;
-        }
+    // Pull every complete command off the buffer; a command split across
+    // reads stays in `input` until the rest arrives. After a malformed
+    // frame the commands before it still run, then the client gets the
+    // error and is closed, as Redis does.
+    std::vector<std::vector<std::string>> commands;
+    std::string protocol_error;
+    try {
+      input.erase(0, parseCommands(input, commands));
+    } catch (const ProtocolError &e) {
+      std::cerr << "Closing client id=" << info->id
+                << ": protocol error: " << e.what() << "\n";
+      protocol_error = e.what();
+      input.clear();
+    }
+    info->touch();
+    info->query_buffer = input.size();
 
-        auto arr = std::dynamic_pointer_cast<Arrays>(root);
-        if (!arr) {
-          std::cerr << "Expected RESP Array\n";
-          break;
-        }
+    // Whatever is left is an incomplete command. Cap it so a client cannot
+    // grow it without bound, e.g. with a huge unterminated bulk string.
+    if (client_registry.queryBufferExceeded(input.size())) {
+      std::cerr << "Closing client id=" << info->id
+                << ": query buffer limit reached\n";
+      break;
+    }
 
-        std::vector<std::string> parts;
-        for (auto &val : arr->values) {
-          auto bulk = std::dynamic_pointer_cast<BulkStrings>(val);
-          if (bulk) {
-            parts.push_back(bulk->value);
-          }
+    // Replies for every command completed by this read are collected here and
+    // sent with a single write, so pipelined clients (e.g. MULTI ... EXEC)
+    // get one segment instead of one small packet per command. A batch that
+    // grows past kReplyFlushBytes is sent early, so a pipeline of large
+    // replies is paced by the client reading them rather than buffered here.
+    std::string reply;
+    bool keep_open = true;
+    for (const auto &parts : commands) {
+      // Executes the command and appends its reply. Keyspace commands take
+      // `store_mutex` internally; EXEC takes it once for the whole batch.
+      handleCommand(parts, client, reply);
+      if (client.output_limit_reached) {
+        std::cerr << "Closing client id=" << info->id
+                  << ": output buffer limit reached\n";
+        keep_open = false;
+        break;
+      }
+      if (reply.size() >= kReplyFlushBytes) {
+        keep_open = sendReply(client_fd, reply, *info);
+        reply.clear();
+        if (!keep_open) {
+          break;
         }
-
-        // This function likely processes the command. If it accesses a shared
-        // resource (like a global key-value store), it must use its own
-        // mutexes internally to ensure thread safety.
-        handleCommand(parts, client_fd);
-
-        // Remove the processed command from the input buffer.
-        input.erase(0, parser.bytesConsumed());
-      } catch (const std::exception &e) {
-        std::cerr << "Parsing error: " << e.what() << "\n";
-        break; // Stop processing on error.
       }
     }
+    if (keep_open && !protocol_error.empty()) {
+      reply += encodeErrorString("ERR Protocol error: " + protocol_error);
+    }
+    if (!keep_open || !sendReply(client_fd, reply, *info) ||
+        client.close_after_reply || !protocol_error.empty()) {
+      break;
+    }
   }
 
-  // Clean up by closing the client's socket connection.
+  // Drop any WATCHed keys so their version counters can be released, then
+  // clean up by closing the client's socket connection. The registry entry
+  // goes first so CLIENT KILL cannot touch the fd once it is closed.
+  releaseClientState(client);
+  client_registry.remove(info->id);
   close(client_fd);
 }
 
-int main(int argc, char **argv) {
-  std::cout << std::unitbuf;
-  std::cerr << std::unitbuf;
+// Formats a peer address as CLIENT LIST shows it: ip:port for TCP and
+// path:0 for Unix socket clients.
+std::string describePeer(int client_fd, const std::string &unixsocket) {
+  struct sockaddr_storage addr {};
+  socklen_t len = sizeof(addr);
+  if (getpeername(client_fd, (struct sockaddr *)&addr, &len) != 0) {
+    return "?:0";
+  }
 
-  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  char ip[INET6_ADDRSTRLEN] = "?";
+  if (addr.ss_family == AF_INET) {
+    auto *addr4 = reinterpret_cast<struct sockaddr_in *>(&addr);
+    inet_ntop(AF_INET, &addr4->sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(addr4->sin_port));
+  }
+  if (addr.ss_family == AF_INET6) {
+    auto *addr6 = reinterpret_cast<struct sockaddr_in6 *>(&addr);
+    inet_ntop(AF_INET6, &addr6->sin6_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(addr6->sin6_port));
+  }
+  return unixsocket + ":0";
+}
+
+// Creates a listening TCP socket on address:port. IPv6 addresses contain ':'.
+// Returns -1 (after logging) on failure.
+int createTcpListener(const std::string &address, int port, int backlog) {
+  bool ipv6 = address.find(':') != std::string::npos;
+  int server_fd = socket(ipv6 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
     std::cerr << "Failed to create server socket\n";
-    return 1;
+    return -1;
   }
 
   int reuse = 1;
   if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) <
       0) {
     std::cerr << "setsockopt failed\n";
-    return 1;
+    close(server_fd);
+    return -1;
+  }
+
+  // Keep IPv6 listeners IPv6-only, as Redis does. Otherwise, with Linux's
+  // default bindv6only=0, "::" also claims the IPv4 port and a separate
+  // 0.0.0.0 listener on the same port fails to bind.
+  if (ipv6) {
+    int v6only = 1;
+    if (setsockopt(server_fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only,
+                   sizeof(v6only)) < 0) {
+      std::cerr << "setsockopt IPV6_V6ONLY failed\n";
+      close(server_fd);
+      return -1;
+    }
+  }
+
+  struct sockaddr_storage server_addr {};
+  socklen_t addr_len;
+  int parsed;
+  if (ipv6) {
+    auto *addr6 = reinterpret_cast<struct sockaddr_in6 *>(&server_addr);
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port = htons(port);
+    parsed = inet_pton(AF_INET6, address.c_str(), &addr6->sin6_addr);
+    addr_len = sizeof(*addr6);
+  } else {
+    auto *addr4 = reinterpret_cast<struct sockaddr_in *>(&server_addr);
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(port);
+    parsed = inet_pton(AF_INET, address.c_str(), &addr4->sin_addr);
+    addr_len = sizeof(*addr4);
+  }
+  if (parsed != 1) {
+    std::cerr << "Invalid bind address " << address << "\n";
+    close(server_fd);
+    return -1;
   }
 
-  struct sockaddr_in server_addr;
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(6379);
+  if (bind(server_fd, (struct sockaddr *)&server_addr, addr_len) != 0) {
+    std::cerr << "Failed to bind to " << address << ":" << port << "\n";
+    close(server_fd);
+    return -1;
+  }
+
+  if (listen(server_fd, backlog) != 0) {
+    std::cerr << "Listen failed\n";
+    close(server_fd);
+    return -1;
+  }
+  return server_fd;
+}
+
+// Creates a listening Unix domain socket at `path`, replacing a stale socket
+// file left by a previous run. Returns -1 (after logging) on failure.
+int createUnixListener(const std::string &path, mode_t perm, int backlog) {
+  struct sockaddr_un server_addr {};
+  if (path.size() >= sizeof(server_addr.sun_path)) {
+    std::cerr << "Unix socket path too long: " << path << "\n";
+    return -1;
+  }
+
+  int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    std::cerr << "Failed to create Unix socket\n";
+    return -1;
+  }
+
+  server_addr.sun_family = AF_UNIX;
+  path.copy(server_addr.sun_path, path.size());
+  unlink(path.c_str());
 
   if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) !=
       0) {
-    std::cerr << "Failed to bind to port 6379\n";
-    return 1;
+    std::cerr << "Failed to bind Unix socket " << path << "\n";
+    close(server_fd);
+    return -1;
+  }
+  if (perm != 0 && chmod(path.c_str(), perm) != 0) {
+    std::cerr << "Failed to set permissions on " << path << "\n";
   }
 
-  int connection_backlog = 5;
-  if (listen(server_fd, connection_backlog) != 0) {
+  if (listen(server_fd, backlog) != 0) {
     std::cerr << "Listen failed\n";
+    close(server_fd);
+    return -1;
+  }
+  return server_fd;
+}
+
+// Applies tcp-nodelay and tcp-keepalive to an accepted TCP connection.
+void configureTcpClient(int client_fd, const ServerConfig &config) {
+  if (config.tcp_nodelay) {
+    // Disable Nagle's algorithm: replies are written once per read, and
+    // holding back a small reply until the previous one is ACKed would stall
+    // pipelined clients on the peer's delayed ACK.
+    int nodelay = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay,
+               sizeof(nodelay));
+  }
+
+  if (config.tcp_keepalive > 0) {
+    int keepalive = 1;
+    setsockopt(client_fd, SOL_SOCKET, SO_KEEPALIVE, &keepalive,
+               sizeof(keepalive));
+#ifdef TCP_KEEPIDLE
+    // Start probing after `tcp_keepalive` idle seconds and give up after
+    // three unanswered probes, roughly twice that interval later.
+    int idle = config.tcp_keepalive;
+    int interval = std::max(1, config.tcp_keepalive / 3);
+    int count = 3;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval,
+               sizeof(interval));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+  }
+}
+
+// Accepts one connection on `listener_fd`, or returns -1 if none was
+// accepted. When the process is out of file descriptors (EMFILE/ENFILE) the
+// pending connection stays in the backlog and keeps the listener readable,
+// so it is accepted on the reserved `spare_fd` and refused instead of
+// letting poll() spin. Persistent errors back off briefly for the same reason.
+int acceptClient(int listener_fd, int &spare_fd) {
+  int client_fd = accept(listener_fd, nullptr, nullptr);
+  if (client_fd >= 0) {
+    return client_fd;
+  }
+
+  int err = errno;
+  if (err == EINTR || err == EAGAIN || err == EWOULDBLOCK ||
+      err == ECONNABORTED || err == EPROTO) {
+    return -1; // The peer went away or nothing is pending; not our problem.
+  }
+  if ((err == EMFILE || err == ENFILE) && spare_fd >= 0) {
+    std::cerr << "Out of file descriptors, refusing a connection\n";
+    close(spare_fd);
+    int refused_fd = accept(listener_fd, nullptr, nullptr);
+    if (refused_fd >= 0) {
+      writeReply(refused_fd, "-ERR max number of clients reached\r\n");
+      close(refused_fd);
+    }
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return -1;
+  }
+
+  std::cerr << "Failed to accept client connection: " << std::strerror(err)
+            << "\n";
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return -1;
+}
+
+int main(int argc, char **argv) {
+  std::cout << std::unitbuf;
+  std::cerr << std::unitbuf;
+
+  ServerConfig config;
+  try {
+    config = parseCommandLine(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << e.what() << "\n";
     return 1;
   }
 
-  while (true) {
-    struct sockaddr_in client_addr;
-    int client_addr_len = sizeof(client_addr);
-    int client_fd = accept(server_fd, (struct sockaddr *)&client_addr,
-                           (socklen_t *)&client_addr_len);
+  // One poll() loop accepts on every listener: each TCP bind address and
+  // the optional Unix socket.
+  std::vector<pollfd> listeners;
+  std::vector<bool> is_tcp;
+  if (config.port != 0) {
+    for (const auto &address : config.bind) {
+      int fd = createTcpListener(address, config.port, config.tcp_backlog);
+      if (fd < 0) {
+        return 1;
+      }
+      listeners.push_back({fd, POLLIN, 0});
+      is_tcp.push_back(true);
+    }
+  }
+  if (!config.unixsocket.empty()) {
+    int fd = createUnixListener(config.unixsocket, config.unixsocketperm,
+                                config.tcp_backlog);
+    if (fd < 0) {
+      return 1;
+    }
+    listeners.push_back({fd, POLLIN, 0});
+    is_tcp.push_back(false);
+  }
+  if (listeners.empty()) {
+    std::cerr << "No listeners configured (port 0 and no unixsocket)\n";
+    return 1;
+  }
+
+  client_registry.setLimits(config);
 
-    if (client_fd < 0) {
-      std::cerr << "Failed to accept client connection\n";
+  // With io-threads > 0, N I/O threads feed a single lock-free command
+  // executor instead of running one thread per client.
+  std::unique_ptr<IOThreadServer> io_server;
+  if (config.io_threads > 0) {
+    io_server = std::make_unique<IOThreadServer>(config.io_threads);
+    std::cout << "Using " << config.io_threads << " I/O threads\n";
+  }
+
+  // Held open so there is always one descriptor to accept (and refuse) a
+  // connection with once the process runs out of them.
+  int spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+  while (true) {
+    if (poll(listeners.data(), listeners.size(), -1) < 0) {
+      int err = errno;
+      if (err == EINTR) {
+        continue;
+      }
+      std::cerr << "poll failed: " << std::strerror(err) << "\n";
+      if (err == EAGAIN || err == ENOMEM) {
+        // Transient resource shortage: wait instead of spinning.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      break; // EFAULT/EINVAL: the poll set itself is broken.
     }
 
-    std::thread client_thread(handleClient, client_fd);
-    client_thread.detach();
+    for (size_t i = 0; i < listeners.size(); ++i) {
+      if (!(listeners[i].revents & POLLIN)) {
+        continue;
+      }
+
+      int client_fd = acceptClient(listeners[i].fd, spare_fd);
+      if (client_fd < 0) {
+        continue;
+      }
+      if (is_tcp[i]) {
+        configureTcpClient(client_fd, config);
+      }
+
+      auto info = client_registry.add(
+          client_fd, describePeer(client_fd, config.unixsocket));
+      if (!info) {
+        writeReply(client_fd, "-ERR max number of clients reached\r\n");
+        close(client_fd);
+        continue;
+      }
+
+      if (io_server) {
+        io_server->addClient(client_fd, info);
+        continue;
+      }
+
+      std::thread client_thread(handleClient, client_fd, info);
+      client_thread.detach();
+    }
   }
 
-  close(server_fd);
-  return EXIT_SUCCESS;
+  // Only reached when poll() fails for good.
+  for (const auto &listener : listeners) {
+    close(listener.fd);
+  }
+  if (spare_fd >= 0) {
+    close(spare_fd);
+  }
+  return EXIT_FAILURE;
 }
@@ -0,0 +1,97 @@
+// Measures the bitmap and HyperLogLog commands per kernel: BITCOUNT and
+// BITOP AND/XOR over two random bitmaps (100 MB each by default), and a
+// multi-key PFCOUNT / PFMERGE over dense sketches.
+//
+// Usage: bitops_bench [megabytes] [iterations] [sketches]
+
+#include "../include/bitops.h"
+#include "../include/handle_command.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string randomBitmap(size_t bytes, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::string out(bytes, '\0');
+  for (size_t i = 0; i + 8 <= bytes; i += 8) {
+    uint64_t word = rng();
+    std::memcpy(&out[i], &word, sizeof(word));
+  }
+  return out;
+}
+
+// Seconds per call of executeCommand(parts), averaged over iterations.
+double secondsPerCommand(const std::vector<std::string> &parts,
+                         int iterations) {
+  ClientState client;
+  std::string reply;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    reply.clear();
+    executeCommand(parts, client, reply);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t megabytes = argc > 1 ? std::atoi(argv[1]) : 100;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+  int sketches = argc > 3 ? std::atoi(argv[3]) : 64;
+
+  size_t bytes = megabytes * 1000 * 1000;
+  store.insert_or_assign("bm:a", StoreValue(randomBitmap(bytes, 1)));
+  store.insert_or_assign("bm:b", StoreValue(randomBitmap(bytes, 2)));
+
+  std::vector<std::string> pfcount = {"PFCOUNT"};
+  std::vector<std::string> pfmerge = {"PFMERGE", "hll:dest"};
+  ClientState client;
+  std::string reply;
+  for (int s = 0; s < sketches; ++s) {
+    std::string key = "hll:" + std::to_string(s);
+    // Enough elements per sketch to promote it to the dense encoding.
+    std::vector<std::string> pfadd = {"PFADD", key};
+    for (int e = 0; e < 20000; ++e) {
+      pfadd.push_back(std::to_string(s) + ":" + std::to_string(e));
+    }
+    executeCommand(pfadd, client, reply);
+    pfcount.push_back(key);
+    pfmerge.push_back(key);
+  }
+
+  std::cout << "bitmaps: 2 x " << megabytes << " MB, HyperLogLog: " << sketches
+            << " dense sketches\n";
+  double mb = static_cast<double>(bytes) / 1e6;
+  for (auto kernel : {BitKernel::Scalar, BitKernel::POPCNT, BitKernel::AVX2}) {
+    if (!bitKernelSupported(kernel))
+      continue;
+    setActiveBitKernel(kernel);
+
+    double bitcount = secondsPerCommand({"BITCOUNT", "bm:a"}, iterations);
+    double bitop_and =
+        secondsPerCommand({"BITOP", "AND", "bm:dest", "bm:a", "bm:b"},
+                          iterations);
+    double bitop_xor =
+        secondsPerCommand({"BITOP", "XOR", "bm:dest", "bm:a", "bm:b"},
+                          iterations);
+    double pf_count = secondsPerCommand(pfcount, iterations);
+    double pf_merge = secondsPerCommand(pfmerge, iterations);
+
+    std::cout << bitKernelName(kernel) << ": BITCOUNT " << mb / bitcount
+              << " MB/s, BITOP AND " << 2 * mb / bitop_and
+              << " MB/s, BITOP XOR " << 2 * mb / bitop_xor << " MB/s, PFCOUNT "
+              << pf_count * 1e6 << " us, PFMERGE " << pf_merge * 1e6
+              << " us\n";
+  }
+  return EXIT_SUCCESS;
+}
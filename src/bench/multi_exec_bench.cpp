@@ -0,0 +1,153 @@
+// Compares 100 SETs sent as individual round trips against the same SETs
+// wrapped in MULTI/EXEC and sent as one pipelined write.
+//
+// Usage: multi_exec_bench [host|unix-socket-path] [port] [iterations]
+// Requires a running redis-server. A host starting with '/' is treated as
+// the server's Unix socket path.
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kCommandsPerBatch = 100;
+
+std::string encodeCommand(const std::string &cmd, const std::string &key,
+                          const std::string &value) {
+  std::string out = "*3\r\n";
+  for (const std::string *arg : {&cmd, &key, &value}) {
+    out += "$" + std::to_string(arg->size()) + "\r\n" + *arg + "\r\n";
+  }
+  return out;
+}
+
+bool writeAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+    if (n <= 0)
+      return false;
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Replies are fixed-size here, so reading an exact byte count is enough.
+bool readExactly(int fd, size_t bytes) {
+  char buffer[4096];
+  while (bytes > 0) {
+    ssize_t n = read(fd, buffer, std::min(bytes, sizeof(buffer)));
+    if (n <= 0)
+      return false;
+    bytes -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+int connectUnix(const std::string &path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path))
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  addr.sun_family = AF_UNIX;
+  path.copy(addr.sun_path, path.size());
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int connectTo(const char *host, int port) {
+  if (host[0] == '/')
+    return connectUnix(host);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+      connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+  int port = argc > 2 ? std::atoi(argv[2]) : 6379;
+  int iterations = argc > 3 ? std::atoi(argv[3]) : 1000;
+
+  int fd = connectTo(host, port);
+  if (fd < 0) {
+    std::cerr << "Failed to connect to " << host << ":" << port << "\n";
+    return 1;
+  }
+
+  std::string sets[kCommandsPerBatch];
+  for (int i = 0; i < kCommandsPerBatch; ++i) {
+    sets[i] = encodeCommand("SET", "bench:key:" + std::to_string(i), "value");
+  }
+
+  const std::string ok = "+OK\r\n";
+  const std::string queued = "+QUEUED\r\n";
+  const std::string exec_header = "*" + std::to_string(kCommandsPerBatch) + "\r\n";
+
+  std::string transaction = "*1\r\n$5\r\nMULTI\r\n";
+  for (const auto &set : sets)
+    transaction += set;
+  transaction += "*1\r\n$4\r\nEXEC\r\n";
+  size_t transaction_reply = ok.size() + kCommandsPerBatch * queued.size() +
+                             exec_header.size() + kCommandsPerBatch * ok.size();
+
+  using clock = std::chrono::steady_clock;
+
+  auto start = clock::now();
+  for (int it = 0; it < iterations; ++it) {
+    for (const auto &set : sets) {
+      if (!writeAll(fd, set) || !readExactly(fd, ok.size())) {
+        std::cerr << "Connection lost\n";
+        return 1;
+      }
+    }
+  }
+  auto round_trips = clock::now() - start;
+
+  start = clock::now();
+  for (int it = 0; it < iterations; ++it) {
+    if (!writeAll(fd, transaction) || !readExactly(fd, transaction_reply)) {
+      std::cerr << "Connection lost\n";
+      return 1;
+    }
+  }
+  auto batched = clock::now() - start;
+  close(fd);
+
+  auto per_batch_us = [&](clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count() / iterations;
+  };
+  std::cout << kCommandsPerBatch << " SET round trips: "
+            << per_batch_us(round_trips) << " us/batch\n";
+  std::cout << "MULTI + " << kCommandsPerBatch
+            << " SET + EXEC:  " << per_batch_us(batched) << " us/batch\n";
+  std::cout << "speedup: " << per_batch_us(round_trips) / per_batch_us(batched)
+            << "x\n";
+  return EXIT_SUCCESS;
+}
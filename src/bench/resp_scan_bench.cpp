@@ -0,0 +1,93 @@
+// Measures RESP framing on pipelined MSET traffic: the CRLF scan per kernel,
+// a find()/stoi() framing loop like the one tokenizer() used to run, and the
+// full tokenizer() with each kernel.
+//
+// Usage: resp_scan_bench [commands] [iterations]
+
+#include "../include/resp_parser.h"
+#include "../include/resp_scan.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string buildMsetPipeline(int commands) {
+  constexpr int kPairs = 10;
+  std::string out;
+  for (int c = 0; c < commands; ++c) {
+    out += "*" + std::to_string(1 + 2 * kPairs) + "\r\n$4\r\nMSET\r\n";
+    for (int p = 0; p < kPairs; ++p) {
+      std::string key = "key:" + std::to_string(c * kPairs + p);
+      std::string value(32, 'v');
+      out += "$" + std::to_string(key.size()) + "\r\n" + key + "\r\n";
+      out += "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+    }
+  }
+  return out;
+}
+
+// Header framing as the old tokenizer did it: find() per line and a
+// temporary substr() for every length prefix.
+size_t findStoiFraming(const std::string &input) {
+  size_t pos = 0;
+  size_t frames = 0;
+  while (pos < input.size()) {
+    char type = input[pos];
+    size_t end = input.find("\r\n", pos);
+    int n = std::stoi(input.substr(pos + 1, end - (pos + 1)));
+    pos = end + 2;
+    if (type == '$') {
+      pos += n + 2; // Skip the bulk payload and its CRLF.
+    }
+    ++frames;
+  }
+  return frames;
+}
+
+template <typename Fn> double mbPerSecond(size_t bytes, int iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    fn();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return bytes * static_cast<double>(iterations) / elapsed.count() / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int commands = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  std::string pipeline = buildMsetPipeline(commands);
+  std::cout << commands << " pipelined MSET commands, " << pipeline.size()
+            << " bytes\n";
+
+  volatile size_t sink = 0;
+  std::cout << "find+stoi framing:  "
+            << mbPerSecond(pipeline.size(), iterations,
+                           [&] { sink = sink + findStoiFraming(pipeline); })
+            << " MB/s\n";
+
+  std::vector<size_t> positions;
+  for (auto kernel : {ScanKernel::Scalar, ScanKernel::SSE2, ScanKernel::AVX2}) {
+    if (!scanKernelSupported(kernel))
+      continue;
+    double scan = mbPerSecond(pipeline.size(), iterations, [&] {
+      positions.clear();
+      findCRLF(pipeline.data(), pipeline.size(), positions, kernel);
+      sink = sink + positions.size();
+    });
+    setActiveScanKernel(kernel);
+    double tokenize = mbPerSecond(pipeline.size(), iterations, [&] {
+      sink = sink + tokenizer(pipeline).size();
+    });
+    std::cout << scanKernelName(kernel) << " CRLF scan: " << scan
+              << " MB/s, tokenizer: " << tokenize << " MB/s\n";
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+#include "./include/bitops.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITOPS_X86 1
+#endif
+
+namespace {
+
+uint64_t loadWord(const uint8_t *p) {
+  uint64_t w;
+  std::memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+void storeWord(uint8_t *p, uint64_t w) { std::memcpy(p, &w, sizeof(w)); }
+
+// Branch-free SWAR popcount, so the scalar path does not depend on the
+// compiler's library fallback for __builtin_popcountll.
+size_t popcountWord(uint64_t w) {
+  w = w - ((w >> 1) & 0x5555555555555555ULL);
+  w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (w * 0x0101010101010101ULL) >> 56;
+}
+
+size_t popcountScalar(const uint8_t *data, size_t len) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    count += popcountWord(loadWord(data + i));
+  }
+  for (; i < len; ++i) {
+    count += popcountWord(data[i]);
+  }
+  return count;
+}
+
+void bitopScalar(BitOp op, uint8_t *dst, const uint8_t *src, size_t len) {
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t a = loadWord(dst + i);
+    uint64_t b = loadWord(src + i);
+    switch (op) {
+    case BitOp::And:
+      a &= b;
+      break;
+    case BitOp::Or:
+      a |= b;
+      break;
+    case BitOp::Xor:
+      a ^= b;
+      break;
+    case BitOp::Not:
+      a = ~b;
+      break;
+    }
+    storeWord(dst + i, a);
+  }
+  for (; i < len; ++i) {
+    switch (op) {
+    case BitOp::And:
+      dst[i] &= src[i];
+      break;
+    case BitOp::Or:
+      dst[i] |= src[i];
+      break;
+    case BitOp::Xor:
+      dst[i] ^= src[i];
+      break;
+    case BitOp::Not:
+      dst[i] = ~src[i];
+      break;
+    }
+  }
+}
+
+void maxBytesScalar(uint8_t *dst, const uint8_t *src, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+}
+
+#ifdef BITOPS_X86
+
+__attribute__((target("popcnt"))) size_t popcountPOPCNT(const uint8_t *data,
+                                                         size_t len) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    count += __builtin_popcountll(loadWord(data + i));
+  }
+  for (; i < len; ++i) {
+    count += __builtin_popcount(data[i]);
+  }
+  return count;
+}
+
+// Nibble lookup popcount (Mula et al.): pshufb maps each 4-bit half to its
+// bit count and psadbw sums the byte counts into four 64-bit lanes.
+__attribute__((target("avx2"))) size_t popcountAVX2(const uint8_t *data,
+                                                     size_t len) {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i total = _mm256_setzero_si256();
+  size_t i = 0;
+  while (i + 32 <= len) {
+    // Byte counts of up to 8 blocks fit in 8 bits (8 * 8 = 64) before the
+    // widening sum.
+    __m256i local = _mm256_setzero_si256();
+    for (int block = 0; block < 8 && i + 32 <= len; ++block, i += 32) {
+      __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+      __m256i lo = _mm256_and_si256(v, low_mask);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+      local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+      local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+    }
+    total = _mm256_add_epi64(total,
+                             _mm256_sad_epu8(local, _mm256_setzero_si256()));
+  }
+  size_t count = _mm256_extract_epi64(total, 0) +
+                 _mm256_extract_epi64(total, 1) +
+                 _mm256_extract_epi64(total, 2) +
+                 _mm256_extract_epi64(total, 3);
+  return count + popcountScalar(data + i, len - i);
+}
+
+__attribute__((target("avx2"))) void
+bitopAVX2(BitOp op, uint8_t *dst, const uint8_t *src, size_t len) {
+  const __m256i ones = _mm256_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    switch (op) {
+    case BitOp::And:
+      a = _mm256_and_si256(a, b);
+      break;
+    case BitOp::Or:
+      a = _mm256_or_si256(a, b);
+      break;
+    case BitOp::Xor:
+      a = _mm256_xor_si256(a, b);
+      break;
+    case BitOp::Not:
+      a = _mm256_xor_si256(b, ones);
+      break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), a);
+  }
+  bitopScalar(op, dst + i, src + i, len - i);
+}
+
+__attribute__((target("avx2"))) void
+maxBytesAVX2(uint8_t *dst, const uint8_t *src, size_t len) {
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        _mm256_max_epu8(a, b));
+  }
+  maxBytesScalar(dst + i, src + i, len - i);
+}
+
+#endif
+
+std::atomic<BitKernel> active_kernel{detectBitKernel()};
+
+} // namespace
+
+BitKernel detectBitKernel() {
+#ifdef BITOPS_X86
+  // Also runs from a static initializer, possibly before libgcc's own.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return BitKernel::AVX2;
+  }
+  if (__builtin_cpu_supports("popcnt")) {
+    return BitKernel::POPCNT;
+  }
+#endif
+  return BitKernel::Scalar;
+}
+
+BitKernel activeBitKernel() {
+  return active_kernel.load(std::memory_order_relaxed);
+}
+
+void setActiveBitKernel(BitKernel kernel) {
+  if (bitKernelSupported(kernel)) {
+    active_kernel.store(kernel, std::memory_order_relaxed);
+  }
+}
+
+bool bitKernelSupported(BitKernel kernel) {
+  switch (kernel) {
+  case BitKernel::Scalar:
+    return true;
+#ifdef BITOPS_X86
+  case BitKernel::POPCNT:
+    return __builtin_cpu_supports("popcnt");
+  case BitKernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *bitKernelName(BitKernel kernel) {
+  switch (kernel) {
+  case BitKernel::Scalar:
+    return "scalar";
+  case BitKernel::POPCNT:
+    return "popcnt";
+  case BitKernel::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+size_t popcount(const uint8_t *data, size_t len, BitKernel kernel) {
+  switch (kernel) {
+#ifdef BITOPS_X86
+  case BitKernel::POPCNT:
+    return popcountPOPCNT(data, len);
+  case BitKernel::AVX2:
+    return popcountAVX2(data, len);
+#endif
+  default:
+    return popcountScalar(data, len);
+  }
+}
+
+size_t popcount(const uint8_t *data, size_t len) {
+  return popcount(data, len, activeBitKernel());
+}
+
+void bitop(BitOp op, uint8_t *dst, const uint8_t *src, size_t len,
+           BitKernel kernel) {
+#ifdef BITOPS_X86
+  if (kernel == BitKernel::AVX2) {
+    bitopAVX2(op, dst, src, len);
+    return;
+  }
+#endif
+  (void)kernel;
+  bitopScalar(op, dst, src, len);
+}
+
+void bitop(BitOp op, uint8_t *dst, const uint8_t *src, size_t len) {
+  bitop(op, dst, src, len, activeBitKernel());
+}
+
+void maxBytes(uint8_t *dst, const uint8_t *src, size_t len, BitKernel kernel) {
+#ifdef BITOPS_X86
+  if (kernel == BitKernel::AVX2) {
+    maxBytesAVX2(dst, src, len);
+    return;
+  }
+#endif
+  (void)kernel;
+  maxBytesScalar(dst, src, len);
+}
+
+void maxBytes(uint8_t *dst, const uint8_t *src, size_t len) {
+  maxBytes(dst, src, len, activeBitKernel());
+}
@@ -0,0 +1,149 @@
+#include "include/clients.h"
+
+#include <sstream>
+#include <sys/socket.h>
+#include <vector>
+
+ClientRegistry client_registry;
+
+namespace {
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+void ClientInfo::touch() {
+  last_interaction_ms.store(nowMs(), std::memory_order_relaxed);
+}
+
+ClientRegistry::ClientRegistry() { setLimits(ServerConfig{}); }
+
+void ClientRegistry::setLimits(const ServerConfig &config) {
+  maxclients_ = config.maxclients;
+  query_buffer_limit_ = config.client_query_buffer_limit;
+  normal_output_limit_ = config.normal_output_limit;
+  pubsub_output_limit_ = config.pubsub_output_limit;
+}
+
+std::shared_ptr<ClientInfo> ClientRegistry::add(int fd, std::string addr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (clients_.size() >= maxclients_) {
+    return nullptr;
+  }
+  auto info = std::make_shared<ClientInfo>();
+  info->id = next_id_++;
+  info->fd = fd;
+  info->addr = std::move(addr);
+  info->touch();
+  clients_.emplace(info->id, info);
+  return info;
+}
+
+void ClientRegistry::remove(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  clients_.erase(id);
+}
+
+size_t ClientRegistry::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return clients_.size();
+}
+
+std::string ClientRegistry::list() const {
+  std::vector<std::shared_ptr<ClientInfo>> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[id, info] : clients_) {
+      snapshot.push_back(info);
+    }
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  int64_t now_ms = nowMs();
+  std::ostringstream out;
+  for (const auto &info : snapshot) {
+    auto age = std::chrono::duration_cast<std::chrono::seconds>(
+        now - info->created);
+    int64_t idle_ms =
+        now_ms - info->last_interaction_ms.load(std::memory_order_relaxed);
+    out << "id=" << info->id << " addr=" << info->addr << " fd=" << info->fd
+        << " age=" << age.count() << " idle=" << idle_ms / 1000 << " flags="
+        << (info->client_class == ClientClass::PubSub ? 'P' : 'N')
+        << " qbuf=" << info->query_buffer.load(std::memory_order_relaxed)
+        << " omem=" << info->output_buffer.load(std::memory_order_relaxed)
+        << "\n";
+  }
+  return out.str();
+}
+
+size_t ClientRegistry::kill(const ClientKillFilter &filter, uint64_t self_id,
+                            bool &matched_self) {
+  matched_self = false;
+  size_t killed = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &[id, info] : clients_) {
+    if ((filter.has_id && id != filter.id) ||
+        (filter.has_addr && info->addr != filter.addr)) {
+      continue;
+    }
+    if (id == self_id) {
+      if (filter.skip_self) {
+        continue;
+      }
+      matched_self = true;
+    } else {
+      // Wakes the connection's reader with EOF; its owner then cleans up.
+      // Holding the lock keeps the fd from being closed and reused first.
+      shutdown(info->fd, SHUT_RDWR);
+    }
+    ++killed;
+  }
+  return killed;
+}
+
+bool ClientRegistry::queryBufferExceeded(size_t bytes) const {
+  return query_buffer_limit_ != 0 && bytes > query_buffer_limit_;
+}
+
+const OutputBufferLimit &
+ClientRegistry::outputLimitFor(const ClientInfo &info) const {
+  return info.client_class == ClientClass::PubSub ? pubsub_output_limit_
+                                                  : normal_output_limit_;
+}
+
+bool ClientRegistry::outputHardLimitExceeded(const ClientInfo &info,
+                                             size_t bytes) const {
+  const OutputBufferLimit &limit = outputLimitFor(info);
+  return limit.hard_bytes != 0 && bytes > limit.hard_bytes;
+}
+
+bool ClientRegistry::outputBufferOverLimit(const ClientInfo &info,
+                                           size_t bytes) const {
+  const OutputBufferLimit &limit = outputLimitFor(info);
+  size_t threshold = limit.soft_bytes != 0 ? limit.soft_bytes : limit.hard_bytes;
+  return threshold != 0 && bytes > threshold;
+}
+
+bool ClientRegistry::outputBufferExceeded(ClientInfo &info,
+                                          size_t bytes) const {
+  const OutputBufferLimit &limit = outputLimitFor(info);
+  if (outputHardLimitExceeded(info, bytes)) {
+    return true;
+  }
+  if (limit.soft_bytes == 0 || bytes <= limit.soft_bytes) {
+    info.soft_limit_since = {};
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (info.soft_limit_since == std::chrono::steady_clock::time_point{}) {
+    info.soft_limit_since = now;
+  }
+  return now - info.soft_limit_since >=
+         std::chrono::seconds(limit.soft_seconds);
+}
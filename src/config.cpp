@@ -0,0 +1,213 @@
+#include "./include/config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string toLower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+  return s;
+}
+
+long long parseInteger(const std::string &name, const std::string &value,
+                       long long min, long long max) {
+  size_t used = 0;
+  long long n = 0;
+  try {
+    n = std::stoll(value, &used);
+  } catch (const std::logic_error &) {
+    used = 0;
+  }
+  if (used != value.size() || value.empty() || n < min || n > max) {
+    throw std::invalid_argument("Invalid value for '" + name + "': " + value);
+  }
+  return n;
+}
+
+bool parseYesNo(const std::string &name, const std::string &value) {
+  std::string v = toLower(value);
+  if (v == "yes") {
+    return true;
+  }
+  if (v == "no") {
+    return false;
+  }
+  throw std::invalid_argument("Argument for '" + name +
+                              "' must be 'yes' or 'no'");
+}
+
+const std::string &singleArg(const std::string &name,
+                             const std::vector<std::string> &args) {
+  if (args.size() != 1) {
+    throw std::invalid_argument("Wrong number of arguments for '" + name +
+                                "'");
+  }
+  return args[0];
+}
+
+} // namespace
+
+size_t parseMemorySize(const std::string &value) {
+  std::string v = toLower(value);
+  size_t digits = 0;
+  while (digits < v.size() &&
+         std::isdigit(static_cast<unsigned char>(v[digits]))) {
+    ++digits;
+  }
+  std::string unit = v.substr(digits);
+  unsigned long long multiplier = 1;
+  if (unit == "k") {
+    multiplier = 1000;
+  } else if (unit == "kb") {
+    multiplier = 1024;
+  } else if (unit == "m") {
+    multiplier = 1000 * 1000;
+  } else if (unit == "mb") {
+    multiplier = 1024 * 1024;
+  } else if (unit == "g") {
+    multiplier = 1000 * 1000 * 1000;
+  } else if (unit == "gb") {
+    multiplier = 1024ULL * 1024 * 1024;
+  } else if (!unit.empty()) {
+    throw std::invalid_argument("Invalid memory size: " + value);
+  }
+  if (digits == 0 || digits > 12) {
+    throw std::invalid_argument("Invalid memory size: " + value);
+  }
+  // 12 digits times a gb multiplier can exceed size_t; a wrapped value
+  // would silently become a tiny limit.
+  size_t bytes = 0;
+  if (__builtin_mul_overflow(std::stoull(v.substr(0, digits)), multiplier,
+                             &bytes)) {
+    throw std::invalid_argument("Invalid memory size: " + value);
+  }
+  return bytes;
+}
+
+void applyConfigOption(ServerConfig &config, const std::string &name,
+                       const std::vector<std::string> &args) {
+  std::string option = toLower(name);
+
+  if (option == "bind") {
+    if (args.empty()) {
+      throw std::invalid_argument("Wrong number of arguments for 'bind'");
+    }
+    config.bind = args;
+  } else if (option == "port") {
+    config.port = parseInteger(option, singleArg(option, args), 0, 65535);
+  } else if (option == "unixsocket") {
+    config.unixsocket = singleArg(option, args);
+  } else if (option == "unixsocketperm") {
+    const std::string &value = singleArg(option, args);
+    size_t used = 0;
+    unsigned long perm = 0;
+    try {
+      perm = std::stoul(value, &used, 8);
+    } catch (const std::logic_error &) {
+      used = 0;
+    }
+    if (used != value.size() || perm > 0777) {
+      throw std::invalid_argument("Invalid value for 'unixsocketperm': " +
+                                  value);
+    }
+    config.unixsocketperm = static_cast<mode_t>(perm);
+  } else if (option == "tcp-backlog") {
+    config.tcp_backlog =
+        parseInteger(option, singleArg(option, args), 1, 65535);
+  } else if (option == "tcp-nodelay") {
+    config.tcp_nodelay = parseYesNo(option, singleArg(option, args));
+  } else if (option == "tcp-keepalive") {
+    config.tcp_keepalive =
+        parseInteger(option, singleArg(option, args), 0, 7200);
+  } else if (option == "io-threads") {
+    config.io_threads = parseInteger(option, singleArg(option, args), 0, 128);
+  } else if (option == "maxclients") {
+    config.maxclients =
+        parseInteger(option, singleArg(option, args), 1, 1000000);
+  } else if (option == "client-query-buffer-limit") {
+    config.client_query_buffer_limit =
+        parseMemorySize(singleArg(option, args));
+  } else if (option == "client-output-buffer-limit") {
+    // <class> <hard> <soft> <soft-seconds>, repeatable on one line.
+    if (args.empty() || args.size() % 4 != 0) {
+      throw std::invalid_argument(
+          "Wrong number of arguments for 'client-output-buffer-limit'");
+    }
+    for (size_t i = 0; i < args.size(); i += 4) {
+      std::string client_class = toLower(args[i]);
+      OutputBufferLimit limit;
+      limit.hard_bytes = parseMemorySize(args[i + 1]);
+      limit.soft_bytes = parseMemorySize(args[i + 2]);
+      limit.soft_seconds = parseInteger(option, args[i + 3], 0, 86400);
+      if (client_class == "normal") {
+        config.normal_output_limit = limit;
+      } else if (client_class == "pubsub") {
+        config.pubsub_output_limit = limit;
+      } else {
+        throw std::invalid_argument("Invalid client class '" + args[i] + "'");
+      }
+    }
+  } else {
+    throw std::invalid_argument("Unknown option '" + name + "'");
+  }
+}
+
+void loadConfigFile(ServerConfig &config, const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::invalid_argument("Can't open config file '" + path + "'");
+  }
+
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+
+    std::istringstream words(line);
+    std::string name;
+    if (!(words >> name)) {
+      continue; // Blank or comment-only line.
+    }
+    std::vector<std::string> args;
+    for (std::string arg; words >> arg;) {
+      args.push_back(arg);
+    }
+
+    try {
+      applyConfigOption(config, name, args);
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument(path + ":" + std::to_string(line_number) +
+                                  ": " + e.what());
+    }
+  }
+}
+
+ServerConfig parseCommandLine(int argc, char **argv) {
+  ServerConfig config;
+  int i = 1;
+  if (i < argc && std::string(argv[i]).rfind("--", 0) != 0) {
+    loadConfigFile(config, argv[i++]);
+  }
+
+  while (i < argc) {
+    std::string arg = argv[i++];
+    if (arg.rfind("--", 0) != 0) {
+      throw std::invalid_argument("Unexpected argument '" + arg + "'");
+    }
+    // An option takes every following argument up to the next `--name`.
+    std::vector<std::string> values;
+    while (i < argc && std::string(argv[i]).rfind("--", 0) != 0) {
+      values.push_back(argv[i++]);
+    }
+    applyConfigOption(config, arg.substr(2), values);
+  }
+  return config;
+}
@@ -1,40 +1,365 @@
 #include "include/handle_command.h"
+#include "include/bitops.h"
+#include "include/hyperloglog.h"
+#include "include/resp_parser.h"
 
 #include <algorithm>
+#include <cstring>
 #include <mutex>
 #include <stdexcept>
 #include <sys/socket.h>
 
 std::unordered_map<std::string, StoreValue> store;
+std::unordered_map<std::string, WatchedKey> watched_keys;
 std::mutex store_mutex;
 
-void handleCommand(const std::vector<std::string> &parts, int client_fd) {
-  if (parts.empty())
+namespace {
+
+std::string toUpper(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+  return s;
+}
+
+// Commands that read or write `store` and therefore need store_mutex.
+bool isKeyspaceCommand(const std::string &cmd_upper) {
+  return cmd_upper == "SET" || cmd_upper == "GET" || cmd_upper == "SETBIT" ||
+         cmd_upper == "GETBIT" || cmd_upper == "BITCOUNT" ||
+         cmd_upper == "BITOP" || cmd_upper == "BITPOS" ||
+         cmd_upper == "PFADD" || cmd_upper == "PFCOUNT" ||
+         cmd_upper == "PFMERGE";
+}
+
+// Commands that are executed immediately even inside MULTI.
+bool isTransactionCommand(const std::string &cmd_upper) {
+  return cmd_upper == "MULTI" || cmd_upper == "EXEC" ||
+         cmd_upper == "DISCARD" || cmd_upper == "WATCH" ||
+         cmd_upper == "UNWATCH";
+}
+
+// Bumps the version of a watched key. Caller holds store_mutex.
+void touchKey(const std::string &key) {
+  if (watched_keys.empty())
     return;
-  std::string cmd_upper = parts[0];
-  std::transform(cmd_upper.begin(), cmd_upper.end(), cmd_upper.begin(),
-                 ::toupper);
+  auto it = watched_keys.find(key);
+  if (it != watched_keys.end()) {
+    ++it->second.version;
+  }
+}
+
+// Caller holds store_mutex.
+void unwatchAllKeys(ClientState &client) {
+  for (const auto &[key, version] : client.watched) {
+    auto it = watched_keys.find(key);
+    if (it != watched_keys.end() && --it->second.watchers == 0) {
+      watched_keys.erase(it);
+    }
+  }
+  client.watched.clear();
+}
+
+// Caller holds store_mutex.
+bool watchedKeysChanged(const ClientState &client) {
+  for (const auto &[key, version] : client.watched) {
+    auto wit = watched_keys.find(key);
+    if (wit == watched_keys.end() || wit->second.version != version) {
+      return true;
+    }
+    // A key that expired after WATCH counts as modified.
+    auto sit = store.find(key);
+    if (sit != store.end() && sit->second.is_expired()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Live value for key, expiring it lazily. Caller holds store_mutex.
+StoreValue *lookupKey(const std::string &key) {
+  auto it = store.find(key);
+  if (it == store.end()) {
+    return nullptr;
+  }
+  if (it->second.is_expired()) {
+    store.erase(it);
+    touchKey(key);
+    return nullptr;
+  }
+  return &it->second;
+}
+
+// Strict integer argument: the whole string must parse.
+bool parseInteger(const std::string &arg, long long &out) {
+  try {
+    size_t pos = 0;
+    out = std::stoll(arg, &pos);
+    return pos == arg.size();
+  } catch (const std::logic_error &) {
+    return false;
+  }
+}
+
+// Bitmap offsets are capped at 2^32 bits (512 MB), as in Redis.
+bool parseBitOffset(const std::string &arg, size_t &offset,
+                    std::string &reply) {
+  long long value;
+  if (!parseInteger(arg, value) || value < 0 || value >= (1LL << 32)) {
+    reply += encodeErrorString("ERR bit offset is not an integer or out of range");
+    return false;
+  }
+  offset = static_cast<size_t>(value);
+  return true;
+}
 
+bool parseBit(const std::string &arg, int &bit, std::string &reply) {
+  if (arg != "0" && arg != "1") {
+    reply += encodeErrorString("ERR bit is not an integer or out of range");
+    return false;
+  }
+  bit = arg[0] - '0';
+  return true;
+}
+
+// Bit 0 is the most significant bit of the first byte.
+int getBit(const std::string &value, size_t offset) {
+  return (static_cast<uint8_t>(value[offset / 8]) >> (7 - offset % 8)) & 1;
+}
+
+// Parses the optional `start end [BYTE|BIT]` arguments of BITCOUNT and
+// BITPOS from parts[first], clamping them to the value the way Redis does.
+// The resulting range [start, end] is in bits; it is empty if start > end.
+bool parseBitRange(const std::vector<std::string> &parts, size_t first,
+                   size_t value_len, long long &start, long long &end,
+                   bool &end_given, std::string &reply) {
+  bool bit_unit = false;
+  end_given = parts.size() > first + 1;
+  if (parts.size() > first + 2) {
+    std::string unit = toUpper(parts[first + 2]);
+    if (parts.size() > first + 3 || (unit != "BYTE" && unit != "BIT")) {
+      reply += encodeErrorString("ERR syntax error");
+      return false;
+    }
+    bit_unit = unit == "BIT";
+  }
+
+  // Length of the value in the units of the range.
+  long long total = static_cast<long long>(value_len) * (bit_unit ? 8 : 1);
+  start = 0;
+  end = total - 1;
+  if (parts.size() > first) {
+    if (!parseInteger(parts[first], start) ||
+        (end_given && !parseInteger(parts[first + 1], end))) {
+      reply += encodeErrorString("ERR value is not an integer or out of range");
+      return false;
+    }
+    if (start < 0)
+      start += total;
+    if (end < 0)
+      end += total;
+    start = std::max(start, 0LL);
+    end = std::min(std::max(end, 0LL), total - 1);
+  }
+  if (!bit_unit) {
+    start *= 8;
+    end = end * 8 + 7;
+  }
+  return true;
+}
+
+// First bit equal to `bit` in bits [first, last], or -1.
+long long findBit(const std::string &value, long long first, long long last,
+                  int bit) {
+  long long pos = first;
+  while (pos <= last && pos % 8 != 0) {
+    if (getBit(value, pos) == bit)
+      return pos;
+    ++pos;
+  }
+
+  // Skip whole bytes with no candidate, a word at a time.
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(value.data());
+  size_t byte = pos / 8;
+  size_t end_byte = (last + 1) / 8;
+  uint8_t skip = bit ? 0x00 : 0xff;
+  uint64_t skip_word = bit ? 0 : ~0ULL;
+  while (byte + 8 <= end_byte) {
+    uint64_t word;
+    std::memcpy(&word, data + byte, sizeof(word));
+    if (word != skip_word)
+      break;
+    byte += 8;
+  }
+  while (byte < end_byte && data[byte] == skip) {
+    ++byte;
+  }
+
+  for (pos = std::max(pos, static_cast<long long>(byte) * 8); pos <= last;
+       ++pos) {
+    if (getBit(value, pos) == bit)
+      return pos;
+  }
+  return -1;
+}
+
+// Reads a PF* key; a missing key yields nullptr. Appends WRONGTYPE and sets
+// `error` if the value is not a sketch.
+StoreValue *lookupHyperLogLog(const std::string &key, bool &error,
+                              std::string &reply) {
+  StoreValue *value = lookupKey(key);
+  if (value != nullptr && !isHyperLogLog(value->value)) {
+    reply += encodeErrorString(
+        "WRONGTYPE Key is not a valid HyperLogLog string value.");
+    error = true;
+  }
+  return value;
+}
+
+// Flags a client whose output still held by its connection plus the reply
+// being built is over the hard limit. Returns true once flagged.
+bool outputLimitReached(ClientState &client, const std::string &reply) {
+  if (!client.output_limit_reached && client.info &&
+      client_registry.outputHardLimitExceeded(
+          *client.info,
+          client.info->output_buffer.load(std::memory_order_relaxed) +
+              reply.size())) {
+    client.output_limit_reached = true;
+  }
+  return client.output_limit_reached;
+}
+
+void resetMulti(ClientState &client) {
+  client.in_multi = false;
+  client.multi_error = false;
+  client.queued.clear();
+}
+
+// Runs a queueable command; returns false if the command is unknown.
+bool runCommand(const std::string &cmd_upper,
+                const std::vector<std::string> &parts, ClientState &client,
+                std::string &reply) {
   if (cmd_upper == "PING") {
-    dprintf(client_fd, "+PONG\r\n");
+    handlePingCommand(reply);
   } else if (cmd_upper == "ECHO") {
-    if (parts.size() > 1) {
-      std::string echo_msg = parts[1];
-      dprintf(client_fd, "$%zu\r\n%s\r\n", echo_msg.size(), echo_msg.c_str());
-    }
+    handleEchoCommand(parts, reply);
   } else if (cmd_upper == "SET") {
-    handleSetCommand(parts, client_fd);
+    handleSetCommand(parts, reply);
   } else if (cmd_upper == "GET") {
-    handleGetCommand(parts, client_fd);
+    handleGetCommand(parts, reply);
+  } else if (cmd_upper == "SETBIT") {
+    handleSetbitCommand(parts, reply);
+  } else if (cmd_upper == "GETBIT") {
+    handleGetbitCommand(parts, reply);
+  } else if (cmd_upper == "BITCOUNT") {
+    handleBitcountCommand(parts, reply);
+  } else if (cmd_upper == "BITOP") {
+    handleBitopCommand(parts, reply);
+  } else if (cmd_upper == "BITPOS") {
+    handleBitposCommand(parts, reply);
+  } else if (cmd_upper == "PFADD") {
+    handlePfaddCommand(parts, reply);
+  } else if (cmd_upper == "PFCOUNT") {
+    handlePfcountCommand(parts, reply);
+  } else if (cmd_upper == "PFMERGE") {
+    handlePfmergeCommand(parts, reply);
+  } else if (cmd_upper == "CLIENT") {
+    handleClientCommand(parts, client, reply);
+  } else if (cmd_upper == "UNWATCH") {
+    // Queued UNWATCH: EXEC has already released the watches.
+    reply += encodeSimpleString("OK");
+  } else {
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+void handleCommand(const std::vector<std::string> &parts, ClientState &client,
+                   std::string &reply) {
+  if (parts.empty())
+    return;
+  std::string cmd_upper = toUpper(parts[0]);
+
+  // Queued commands do not touch the keyspace until EXEC, which runs the
+  // whole batch under a single acquisition of store_mutex.
+  bool needs_lock = isTransactionCommand(cmd_upper) ||
+                    (!client.in_multi && isKeyspaceCommand(cmd_upper));
+
+  if (needs_lock) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    executeCommand(parts, client, reply);
   } else {
-    dprintf(client_fd, "-ERR unknown command '%s'\r\n", parts[0].c_str());
+    executeCommand(parts, client, reply);
+  }
+}
+
+void writeReply(int client_fd, const std::string &reply) {
+  size_t sent = 0;
+  while (sent < reply.size()) {
+    ssize_t n = send(client_fd, reply.data() + sent, reply.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n <= 0) {
+      return; // Client went away; the read loop will notice.
+    }
+    sent += static_cast<size_t>(n);
   }
 }
 
+void executeCommand(const std::vector<std::string> &parts, ClientState &client,
+                    std::string &reply) {
+  if (parts.empty() || client.output_limit_reached)
+    return;
+  std::string cmd_upper = toUpper(parts[0]);
 
-void handleSetCommand(const std::vector<std::string> &parts, int fd) {
+  if (cmd_upper == "MULTI") {
+    handleMultiCommand(client, reply);
+  } else if (cmd_upper == "EXEC") {
+    handleExecCommand(client, reply);
+  } else if (cmd_upper == "DISCARD") {
+    handleDiscardCommand(client, reply);
+  } else if (cmd_upper == "WATCH") {
+    handleWatchCommand(parts, client, reply);
+  } else if (cmd_upper == "UNWATCH" && !client.in_multi) {
+    handleUnwatchCommand(client, reply);
+  } else if (client.in_multi) {
+    if (cmd_upper != "PING" && cmd_upper != "ECHO" && cmd_upper != "CLIENT" &&
+        cmd_upper != "UNWATCH" && !isKeyspaceCommand(cmd_upper)) {
+      client.multi_error = true;
+      reply += encodeErrorString("ERR unknown command '" + parts[0] + "'");
+      return;
+    }
+    client.queued.push_back(parts);
+    reply += encodeSimpleString("QUEUED");
+  } else if (!runCommand(cmd_upper, parts, client, reply)) {
+    reply += encodeErrorString("ERR unknown command '" + parts[0] + "'");
+  }
+  outputLimitReached(client, reply);
+}
+
+void releaseClientState(ClientState &client) {
+  std::lock_guard<std::mutex> lock(store_mutex);
+  unwatchAllKeys(client);
+  resetMulti(client);
+}
+
+void handlePingCommand(std::string &reply) {
+  reply += encodeSimpleString("PONG");
+}
+
+void handleEchoCommand(const std::vector<std::string> &parts,
+                       std::string &reply) {
+  if (parts.size() < 2) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'echo' command");
+    return;
+  }
+  reply += encodeBulkString(parts[1]);
+}
+
+void handleSetCommand(const std::vector<std::string> &parts,
+                      std::string &reply) {
   if (parts.size() < 3) {
-    dprintf(fd, "-ERR wrong number of arguments for 'set' command\r\n");
+    reply +=
+        encodeErrorString("ERR wrong number of arguments for 'set' command");
     return;
   }
 
@@ -44,14 +369,13 @@ void handleSetCommand(const std::vector<std::string> &parts, int fd) {
   bool nx_enabled = false;
 
   for (size_t i = 3; i < parts.size(); ++i) {
-    std::string option = parts[i];
-    std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+    std::string option = toUpper(parts[i]);
 
     if (option == "PX" && i + 1 < parts.size()) {
       try {
         px_expiry_ms = std::stoll(parts[++i]);
-      } catch (const std::invalid_argument &) {
-        dprintf(fd, "-ERR value is not an integer or out of range\r\n");
+      } catch (const std::logic_error &) {
+        reply += encodeErrorString("ERR value is not an integer or out of range");
         return;
       }
     } else if (option == "NX") {
@@ -65,40 +389,490 @@ void handleSetCommand(const std::vector<std::string> &parts, int fd) {
 
   if (nx_enabled) {
     // Only set if the key does not already exist
-    std::lock_guard<std::mutex> lock(store_mutex);
-    if (store.count(key) > 0) {
-      dprintf(fd, "$-1\r\n"); // Return Null Bulk String for NX when key exists
+    auto it = store.find(key);
+    if (it != store.end() && !it->second.is_expired()) {
+      reply += encodeNullBulkString(); // Null Bulk String for NX when key exists
       return;
     }
-    store.insert_or_assign(key, std::move(store_value));
-  } else {
-    std::lock_guard<std::mutex> lock(store_mutex);
-    store.insert_or_assign(key, std::move(store_value));
   }
+  store.insert_or_assign(key, std::move(store_value));
+  touchKey(key);
 
-  dprintf(fd, "+OK\r\n");
+  reply += encodeSimpleString("OK");
 }
 
-void handleGetCommand(const std::vector<std::string> &parts, int fd) {
+void handleGetCommand(const std::vector<std::string> &parts,
+                      std::string &reply) {
   if (parts.size() < 2) {
-    dprintf(fd, "-ERR wrong number of arguments for 'get' command\r\n");
+    reply +=
+        encodeErrorString("ERR wrong number of arguments for 'get' command");
     return;
   }
 
   const std::string &key = parts[1];
 
-  std::lock_guard<std::mutex> lock(store_mutex);
   auto it = store.find(key);
 
   if (it == store.end()) {
-    dprintf(fd, "$-1\r\n"); // Null Bulk String for non-existent key
+    reply += encodeNullBulkString(); // Null Bulk String for non-existent key
+  } else if (it->second.is_expired()) {
+    store.erase(it);
+    touchKey(key);
+    reply += encodeNullBulkString(); // Null Bulk String for expired key
+  } else {
+    reply += encodeBulkString(it->second.value);
+  }
+}
+
+void handleSetbitCommand(const std::vector<std::string> &parts,
+                         std::string &reply) {
+  if (parts.size() != 4) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'setbit' command");
+    return;
+  }
+  size_t offset;
+  int bit;
+  if (!parseBitOffset(parts[2], offset, reply) || !parseBit(parts[3], bit, reply))
+    return;
+
+  const std::string &key = parts[1];
+  StoreValue *value = lookupKey(key);
+  if (value == nullptr) {
+    value = &store.insert_or_assign(key, StoreValue("")).first->second;
+  }
+  // Updated in place so the key keeps its expiry.
+  std::string &bits = value->value;
+  size_t byte = offset / 8;
+  if (byte >= bits.size()) {
+    bits.resize(byte + 1, '\0');
+  }
+  int old_bit = getBit(bits, offset);
+  uint8_t mask = 1 << (7 - offset % 8);
+  if (bit) {
+    bits[byte] = static_cast<char>(static_cast<uint8_t>(bits[byte]) | mask);
   } else {
-    if (it->second.is_expired()) {
-      store.erase(it);
-      dprintf(fd, "$-1\r\n"); // Null Bulk String for expired key
+    bits[byte] = static_cast<char>(static_cast<uint8_t>(bits[byte]) & ~mask);
+  }
+  touchKey(key);
+  reply += encodeInteger(old_bit);
+}
+
+void handleGetbitCommand(const std::vector<std::string> &parts,
+                         std::string &reply) {
+  if (parts.size() != 3) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'getbit' command");
+    return;
+  }
+  size_t offset;
+  if (!parseBitOffset(parts[2], offset, reply))
+    return;
+
+  StoreValue *value = lookupKey(parts[1]);
+  if (value == nullptr || offset / 8 >= value->value.size()) {
+    reply += encodeInteger(0);
+    return;
+  }
+  reply += encodeInteger(getBit(value->value, offset));
+}
+
+void handleBitcountCommand(const std::vector<std::string> &parts,
+                           std::string &reply) {
+  // BITCOUNT key [start end [BYTE|BIT]]: a lone start is a syntax error.
+  if (parts.size() < 2 || parts.size() == 3) {
+    reply += encodeErrorString(parts.size() < 2
+                                   ? "ERR wrong number of arguments for "
+                                     "'bitcount' command"
+                                   : "ERR syntax error");
+    return;
+  }
+
+  StoreValue *value = lookupKey(parts[1]);
+  const std::string empty;
+  const std::string &bits = value != nullptr ? value->value : empty;
+  long long start, end;
+  bool end_given;
+  if (!parseBitRange(parts, 2, bits.size(), start, end, end_given, reply))
+    return;
+  if (start > end) {
+    reply += encodeInteger(0);
+    return;
+  }
+
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(bits.data());
+  size_t first_byte = start / 8;
+  size_t last_byte = end / 8;
+  long long count = popcount(data + first_byte, last_byte - first_byte + 1);
+  // Drop the bits of the edge bytes that fall outside a BIT range.
+  uint8_t head = data[first_byte] & ~(0xff >> (start % 8));
+  uint8_t tail = data[last_byte] & (0xff >> (end % 8 + 1));
+  count -= popcount(&head, 1) + popcount(&tail, 1);
+  reply += encodeInteger(count);
+}
+
+void handleBitopCommand(const std::vector<std::string> &parts,
+                        std::string &reply) {
+  if (parts.size() < 4) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'bitop' command");
+    return;
+  }
+
+  std::string op_name = toUpper(parts[1]);
+  BitOp op;
+  if (op_name == "AND") {
+    op = BitOp::And;
+  } else if (op_name == "OR") {
+    op = BitOp::Or;
+  } else if (op_name == "XOR") {
+    op = BitOp::Xor;
+  } else if (op_name == "NOT") {
+    op = BitOp::Not;
+  } else {
+    reply += encodeErrorString("ERR syntax error");
+    return;
+  }
+  if (op == BitOp::Not && parts.size() != 4) {
+    reply += encodeErrorString(
+        "ERR BITOP NOT must be called with a single source key.");
+    return;
+  }
+
+  // Missing keys are empty strings; shorter inputs are zero-padded.
+  std::vector<const std::string *> sources;
+  size_t max_len = 0;
+  for (size_t i = 3; i < parts.size(); ++i) {
+    StoreValue *value = lookupKey(parts[i]);
+    sources.push_back(value != nullptr ? &value->value : nullptr);
+    if (value != nullptr) {
+      max_len = std::max(max_len, value->value.size());
+    }
+  }
+
+  std::string result(max_len, '\0');
+  uint8_t *dst = reinterpret_cast<uint8_t *>(result.data());
+  for (size_t i = 0; i < sources.size(); ++i) {
+    size_t len = sources[i] != nullptr ? sources[i]->size() : 0;
+    const uint8_t *src =
+        len > 0 ? reinterpret_cast<const uint8_t *>(sources[i]->data())
+                : nullptr;
+    if (i == 0 && op != BitOp::Not) {
+      if (len > 0) {
+        std::memcpy(dst, src, len);
+      }
+      continue;
+    }
+    if (len > 0) {
+      bitop(op, dst, src, len);
+    }
+    if (op == BitOp::And) {
+      std::memset(dst + len, 0, max_len - len);
+    } else if (op == BitOp::Not) {
+      std::memset(dst + len, 0xff, max_len - len);
+    }
+  }
+
+  const std::string &dest = parts[2];
+  if (result.empty()) {
+    store.erase(dest);
+  } else {
+    store.insert_or_assign(dest, StoreValue(std::move(result)));
+  }
+  touchKey(dest);
+  reply += encodeInteger(static_cast<long long>(max_len));
+}
+
+void handleBitposCommand(const std::vector<std::string> &parts,
+                         std::string &reply) {
+  if (parts.size() < 3) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'bitpos' command");
+    return;
+  }
+  int bit;
+  if (!parseBit(parts[2], bit, reply))
+    return;
+
+  StoreValue *value = lookupKey(parts[1]);
+  const std::string empty;
+  const std::string &bits = value != nullptr ? value->value : empty;
+  long long start, end;
+  bool end_given;
+  if (!parseBitRange(parts, 3, bits.size(), start, end, end_given, reply))
+    return;
+  if (value == nullptr) {
+    // A missing key is an infinite run of zeros.
+    reply += encodeInteger(bit ? -1 : 0);
+    return;
+  }
+  if (start > end) {
+    reply += encodeInteger(-1);
+    return;
+  }
+
+  long long pos = findBit(bits, start, end, bit);
+  if (pos == -1 && bit == 0 && !end_given) {
+    // Without an explicit end the string is treated as zero-padded.
+    pos = end + 1;
+  }
+  reply += encodeInteger(pos);
+}
+
+void handlePfaddCommand(const std::vector<std::string> &parts,
+                        std::string &reply) {
+  if (parts.size() < 2) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'pfadd' command");
+    return;
+  }
+
+  const std::string &key = parts[1];
+  bool error = false;
+  StoreValue *value = lookupHyperLogLog(key, error, reply);
+  if (error)
+    return;
+
+  bool changed = false;
+  if (value == nullptr) {
+    value = &store.insert_or_assign(key, StoreValue(hllCreate())).first->second;
+    changed = true;
+  }
+  for (size_t i = 2; i < parts.size(); ++i) {
+    changed |= hllAdd(value->value, parts[i]);
+  }
+  if (changed) {
+    touchKey(key);
+  }
+  reply += encodeInteger(changed ? 1 : 0);
+}
+
+void handlePfcountCommand(const std::vector<std::string> &parts,
+                          std::string &reply) {
+  if (parts.size() < 2) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'pfcount' command");
+    return;
+  }
+
+  bool error = false;
+  if (parts.size() == 2) {
+    // Single key: served from, or refreshes, the cached cardinality.
+    StoreValue *value = lookupHyperLogLog(parts[1], error, reply);
+    if (!error) {
+      reply += encodeInteger(
+          value != nullptr ? static_cast<long long>(hllCount(value->value))
+                           : 0);
+    }
+    return;
+  }
+
+  // Several keys: count the union without touching any of them.
+  std::vector<uint8_t> registers(kHllRegisters, 0);
+  for (size_t i = 1; i < parts.size(); ++i) {
+    StoreValue *value = lookupHyperLogLog(parts[i], error, reply);
+    if (error)
+      return;
+    if (value != nullptr) {
+      hllMergeInto(value->value, registers.data());
+    }
+  }
+  reply += encodeInteger(
+      static_cast<long long>(hllCountRegisters(registers.data())));
+}
+
+void handlePfmergeCommand(const std::vector<std::string> &parts,
+                          std::string &reply) {
+  if (parts.size() < 2) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'pfmerge' command");
+    return;
+  }
+
+  // The destination takes part in the union, as in Redis.
+  std::vector<uint8_t> registers(kHllRegisters, 0);
+  bool error = false;
+  for (size_t i = 1; i < parts.size(); ++i) {
+    StoreValue *value = lookupHyperLogLog(parts[i], error, reply);
+    if (error)
+      return;
+    if (value != nullptr) {
+      hllMergeInto(value->value, registers.data());
+    }
+  }
+
+  const std::string &dest = parts[1];
+  std::string merged = hllFromRegisters(registers.data());
+  StoreValue *value = lookupKey(dest);
+  if (value != nullptr) {
+    value->value = std::move(merged); // keeps the destination's expiry
+  } else {
+    store.insert_or_assign(dest, StoreValue(std::move(merged)));
+  }
+  touchKey(dest);
+  reply += encodeSimpleString("OK");
+}
+
+void handleMultiCommand(ClientState &client, std::string &reply) {
+  if (client.in_multi) {
+    reply += encodeErrorString("ERR MULTI calls can not be nested");
+    return;
+  }
+  client.in_multi = true;
+  reply += encodeSimpleString("OK");
+}
+
+void handleExecCommand(ClientState &client, std::string &reply) {
+  if (!client.in_multi) {
+    reply += encodeErrorString("ERR EXEC without MULTI");
+    return;
+  }
+  if (client.multi_error) {
+    resetMulti(client);
+    unwatchAllKeys(client);
+    reply += encodeErrorString(
+        "EXECABORT Transaction discarded because of previous errors.");
+    return;
+  }
+
+  bool aborted = watchedKeysChanged(client);
+  std::vector<std::vector<std::string>> queued = std::move(client.queued);
+  resetMulti(client);
+  unwatchAllKeys(client);
+
+  if (aborted) {
+    reply += "*-1\r\n"; // Null Array: a watched key was modified
+    return;
+  }
+
+  reply += "*" + std::to_string(queued.size()) + "\r\n";
+  std::string discarded;
+  for (const auto &cmd_parts : queued) {
+    // Past the output limit the client is closed without its reply, but the
+    // rest of the transaction still runs so it stays all-or-nothing; only
+    // the replies are dropped instead of buffered.
+    std::string &out = outputLimitReached(client, reply) ? discarded : reply;
+    runCommand(toUpper(cmd_parts[0]), cmd_parts, client, out);
+    discarded.clear();
+  }
+}
+
+void handleDiscardCommand(ClientState &client, std::string &reply) {
+  if (!client.in_multi) {
+    reply += encodeErrorString("ERR DISCARD without MULTI");
+    return;
+  }
+  resetMulti(client);
+  unwatchAllKeys(client);
+  reply += encodeSimpleString("OK");
+}
+
+void handleWatchCommand(const std::vector<std::string> &parts,
+                        ClientState &client, std::string &reply) {
+  if (client.in_multi) {
+    reply += encodeErrorString("ERR WATCH inside MULTI is not allowed");
+    return;
+  }
+  if (parts.size() < 2) {
+    reply +=
+        encodeErrorString("ERR wrong number of arguments for 'watch' command");
+    return;
+  }
+
+  for (size_t i = 1; i < parts.size(); ++i) {
+    const std::string &key = parts[i];
+    if (client.watched.count(key) > 0)
+      continue;
+
+    // Expire lazily first so a key that is already gone is not later
+    // reported as modified by EXEC.
+    auto sit = store.find(key);
+    if (sit != store.end() && sit->second.is_expired()) {
+      store.erase(sit);
+      touchKey(key);
+    }
+
+    WatchedKey &watched = watched_keys[key];
+    ++watched.watchers;
+    client.watched.emplace(key, watched.version);
+  }
+  reply += encodeSimpleString("OK");
+}
+
+void handleUnwatchCommand(ClientState &client, std::string &reply) {
+  unwatchAllKeys(client);
+  reply += encodeSimpleString("OK");
+}
+
+void handleClientCommand(const std::vector<std::string> &parts,
+                         ClientState &client, std::string &reply) {
+  if (parts.size() < 2) {
+    reply += encodeErrorString(
+        "ERR wrong number of arguments for 'client' command");
+    return;
+  }
+  std::string subcommand = toUpper(parts[1]);
+  uint64_t self_id = client.info ? client.info->id : 0;
+
+  if (subcommand == "ID") {
+    reply += encodeInteger(static_cast<long long>(self_id));
+  } else if (subcommand == "LIST") {
+    reply += encodeBulkString(client_registry.list());
+  } else if (subcommand == "KILL") {
+    ClientKillFilter filter;
+    bool legacy = parts.size() == 3;
+    if (legacy) {
+      // CLIENT KILL ip:port
+      filter.has_addr = true;
+      filter.addr = parts[2];
+      filter.skip_self = false;
+    } else if (parts.size() < 4 || parts.size() % 2 != 0) {
+      reply += encodeErrorString("ERR syntax error");
+      return;
+    }
+
+    for (size_t i = 2; !legacy && i + 1 < parts.size(); i += 2) {
+      std::string option = toUpper(parts[i]);
+      const std::string &value = parts[i + 1];
+      if (option == "ID") {
+        // Signed parse: stoull would wrap "-1", and 0 is never a client ID.
+        long long id;
+        if (!parseInteger(value, id) || id <= 0) {
+          reply += encodeErrorString("ERR client-id should be greater than 0");
+          return;
+        }
+        filter.has_id = true;
+        filter.id = static_cast<uint64_t>(id);
+      } else if (option == "ADDR") {
+        filter.has_addr = true;
+        filter.addr = value;
+      } else if (option == "SKIPME") {
+        std::string skip = toUpper(value);
+        if (skip != "YES" && skip != "NO") {
+          reply += encodeErrorString("ERR syntax error");
+          return;
+        }
+        filter.skip_self = skip == "YES";
+      } else {
+        reply += encodeErrorString("ERR syntax error");
+        return;
+      }
+    }
+
+    bool matched_self = false;
+    size_t killed = client_registry.kill(filter, self_id, matched_self);
+    if (matched_self) {
+      client.close_after_reply = true;
+    }
+    if (!legacy) {
+      reply += encodeInteger(static_cast<long long>(killed));
+    } else if (killed == 0) {
+      reply += encodeErrorString("ERR No such client");
     } else {
-      dprintf(fd, "$%zu\r\n%s\r\n", it->second.value.size(),
-              it->second.value.c_str());
+      reply += encodeSimpleString("OK");
     }
+  } else {
+    reply += encodeErrorString("ERR unknown subcommand '" + parts[1] +
+                               "'. Try CLIENT LIST, CLIENT KILL or CLIENT ID.");
   }
 }
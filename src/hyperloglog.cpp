@@ -0,0 +1,387 @@
+#include "./include/hyperloglog.h"
+#include "./include/bitops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int kHllQ = 50; // hash bits left after the 14 index bits
+constexpr uint8_t kEncodingDense = 0;
+constexpr uint8_t kEncodingSparse = 1;
+constexpr int kSparseMaxValue = 32;
+constexpr double kAlphaInf = 0.721347520444481703680;
+
+// Sparse opcodes: ZERO 00xxxxxx (1-64 empty registers), XZERO 01xxxxxx
+// yyyyyyyy (1-16384 empty registers), VAL 1vvvvvxx (1-4 registers set to
+// value 1-32).
+constexpr size_t kZeroMaxLen = 64;
+constexpr size_t kXZeroMaxLen = 16384;
+constexpr size_t kValMaxLen = 4;
+
+uint64_t murmurHash64A(const void *key, size_t len, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  uint64_t h = seed ^ (len * m);
+  const uint8_t *data = static_cast<const uint8_t *>(key);
+  const uint8_t *end = data + (len - (len & 7));
+
+  while (data != end) {
+    uint64_t k;
+    std::memcpy(&k, data, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+    data += 8;
+  }
+
+  switch (len & 7) {
+  case 7:
+    h ^= static_cast<uint64_t>(data[6]) << 48;
+    [[fallthrough]];
+  case 6:
+    h ^= static_cast<uint64_t>(data[5]) << 40;
+    [[fallthrough]];
+  case 5:
+    h ^= static_cast<uint64_t>(data[4]) << 32;
+    [[fallthrough]];
+  case 4:
+    h ^= static_cast<uint64_t>(data[3]) << 24;
+    [[fallthrough]];
+  case 3:
+    h ^= static_cast<uint64_t>(data[2]) << 16;
+    [[fallthrough]];
+  case 2:
+    h ^= static_cast<uint64_t>(data[1]) << 8;
+    [[fallthrough]];
+  case 1:
+    h ^= static_cast<uint64_t>(data[0]);
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+// Register index and run length of trailing zeros plus one (1-51).
+std::pair<size_t, uint8_t> hashElement(const std::string &element) {
+  uint64_t hash = murmurHash64A(element.data(), element.size(), 0xadc83b19ULL);
+  size_t index = hash & (kHllRegisters - 1);
+  hash >>= 14;
+  hash |= 1ULL << kHllQ; // bounds the count
+  uint8_t count = 1;
+  while ((hash & 1) == 0) {
+    ++count;
+    hash >>= 1;
+  }
+  return {index, count};
+}
+
+uint8_t *body(std::string &hll) {
+  return reinterpret_cast<uint8_t *>(&hll[kHllHeaderSize]);
+}
+
+const uint8_t *body(const std::string &hll) {
+  return reinterpret_cast<const uint8_t *>(hll.data() + kHllHeaderSize);
+}
+
+void invalidateCache(std::string &hll) { hll[15] |= static_cast<char>(0x80); }
+
+// Registers are packed LSB first, so every 4 registers fill exactly 3 bytes.
+uint8_t denseGet(const uint8_t *regs, size_t index) {
+  size_t bit = index * 6;
+  size_t byte = bit / 8;
+  unsigned shift = bit % 8;
+  unsigned value = regs[byte] >> shift;
+  if (shift > 2) {
+    value |= regs[byte + 1] << (8 - shift);
+  }
+  return value & 63;
+}
+
+void denseSet(uint8_t *regs, size_t index, uint8_t value) {
+  size_t bit = index * 6;
+  size_t byte = bit / 8;
+  unsigned shift = bit % 8;
+  regs[byte] = (regs[byte] & ~(63u << shift)) | (value << shift);
+  if (shift > 2) {
+    unsigned high = 8 - shift;
+    regs[byte + 1] = (regs[byte + 1] & ~(63u >> high)) | (value >> high);
+  }
+}
+
+void denseUnpack(const uint8_t *regs, uint8_t *out) {
+  for (size_t i = 0; i < kHllRegisters; i += 4, regs += 3) {
+    out[i] = regs[0] & 63;
+    out[i + 1] = (regs[0] >> 6) | ((regs[1] & 15) << 2);
+    out[i + 2] = (regs[1] >> 4) | ((regs[2] & 3) << 4);
+    out[i + 3] = regs[2] >> 2;
+  }
+}
+
+void densePack(const uint8_t *in, uint8_t *regs) {
+  for (size_t i = 0; i < kHllRegisters; i += 4, regs += 3) {
+    regs[0] = in[i] | (in[i + 1] << 6);
+    regs[1] = (in[i + 1] >> 2) | (in[i + 2] << 4);
+    regs[2] = (in[i + 2] >> 4) | (in[i + 3] << 2);
+  }
+}
+
+std::string makeHeader(uint8_t encoding) {
+  std::string header(kHllHeaderSize, '\0');
+  header[0] = 'H';
+  header[1] = 'Y';
+  header[2] = 'L';
+  header[3] = 'L';
+  header[4] = static_cast<char>(encoding);
+  invalidateCache(header);
+  return header;
+}
+
+// Calls fn(index, value, run) for every non-empty run of the sparse body.
+// Returns false if the body is malformed or does not cover every register.
+template <typename Fn> bool forEachSparseRun(const std::string &hll, Fn fn) {
+  const uint8_t *p = body(hll);
+  const uint8_t *end = p + (hll.size() - kHllHeaderSize);
+  size_t index = 0;
+  while (p < end) {
+    uint8_t op = *p++;
+    size_t run;
+    if ((op & 0xc0) == 0x00) {
+      run = (op & 0x3f) + 1;
+    } else if ((op & 0xc0) == 0x40) {
+      if (p == end) {
+        return false;
+      }
+      run = (((op & 0x3f) << 8) | *p++) + 1;
+    } else {
+      run = (op & 0x03) + 1;
+      if (index + run > kHllRegisters) {
+        return false;
+      }
+      fn(index, static_cast<uint8_t>(((op >> 2) & 0x1f) + 1), run);
+    }
+    index += run;
+    if (index > kHllRegisters) {
+      return false;
+    }
+  }
+  return index == kHllRegisters;
+}
+
+// Non-zero registers of a sparse sketch, ordered by index.
+std::vector<std::pair<uint16_t, uint8_t>> sparseDecode(const std::string &hll) {
+  std::vector<std::pair<uint16_t, uint8_t>> regs;
+  forEachSparseRun(hll, [&](size_t index, uint8_t value, size_t run) {
+    for (size_t i = 0; i < run; ++i) {
+      regs.emplace_back(static_cast<uint16_t>(index + i), value);
+    }
+  });
+  return regs;
+}
+
+void appendZeros(std::string &out, size_t run) {
+  while (run > 0) {
+    if (run <= kZeroMaxLen) {
+      out.push_back(static_cast<char>(run - 1));
+      return;
+    }
+    size_t len = std::min(run, kXZeroMaxLen);
+    out.push_back(static_cast<char>(0x40 | ((len - 1) >> 8)));
+    out.push_back(static_cast<char>((len - 1) & 0xff));
+    run -= len;
+  }
+}
+
+// Re-encodes sorted non-zero registers (all <= kSparseMaxValue) as a
+// sparse body.
+std::string sparseEncode(const std::vector<std::pair<uint16_t, uint8_t>> &regs) {
+  std::string out = makeHeader(kEncodingSparse);
+  size_t next = 0;
+  for (size_t i = 0; i < regs.size();) {
+    size_t index = regs[i].first;
+    uint8_t value = regs[i].second;
+    size_t run = 1;
+    while (run < kValMaxLen && i + run < regs.size() &&
+           regs[i + run].first == index + run &&
+           regs[i + run].second == value) {
+      ++run;
+    }
+    appendZeros(out, index - next);
+    out.push_back(static_cast<char>(0x80 | ((value - 1) << 2) | (run - 1)));
+    next = index + run;
+    i += run;
+  }
+  appendZeros(out, kHllRegisters - next);
+  return out;
+}
+
+double hllSigma(double x) {
+  if (x == 1.0) {
+    return INFINITY;
+  }
+  double z_prime;
+  double y = 1;
+  double z = x;
+  do {
+    x *= x;
+    z_prime = z;
+    z += x * y;
+    y += y;
+  } while (z_prime != z);
+  return z;
+}
+
+double hllTau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double z_prime;
+  double y = 1.0;
+  double z = 1 - x;
+  do {
+    x = std::sqrt(x);
+    z_prime = z;
+    y *= 0.5;
+    z -= std::pow(1 - x, 2) * y;
+  } while (z_prime != z);
+  return z / 3;
+}
+
+} // namespace
+
+std::string hllCreate() {
+  std::string hll = makeHeader(kEncodingSparse);
+  appendZeros(hll, kHllRegisters);
+  return hll;
+}
+
+bool hllIsSparse(const std::string &hll) {
+  return static_cast<uint8_t>(hll[4]) == kEncodingSparse;
+}
+
+bool isHyperLogLog(const std::string &value) {
+  if (value.size() < kHllHeaderSize || value.compare(0, 4, "HYLL") != 0) {
+    return false;
+  }
+  uint8_t encoding = static_cast<uint8_t>(value[4]);
+  if (encoding == kEncodingDense) {
+    return value.size() == kHllDenseSize;
+  }
+  if (encoding == kEncodingSparse) {
+    return forEachSparseRun(value, [](size_t, uint8_t, size_t) {});
+  }
+  return false;
+}
+
+bool hllAdd(std::string &hll, const std::string &element) {
+  auto [index, count] = hashElement(element);
+
+  if (!hllIsSparse(hll)) {
+    uint8_t *regs = body(hll);
+    if (denseGet(regs, index) >= count) {
+      return false;
+    }
+    denseSet(regs, index, count);
+    invalidateCache(hll);
+    return true;
+  }
+
+  auto regs = sparseDecode(hll);
+  auto it = std::lower_bound(
+      regs.begin(), regs.end(), index,
+      [](const std::pair<uint16_t, uint8_t> &reg, size_t i) {
+        return reg.first < i;
+      });
+  if (it != regs.end() && it->first == index) {
+    if (it->second >= count) {
+      return false;
+    }
+    it->second = count;
+  } else {
+    regs.insert(it, {static_cast<uint16_t>(index), count});
+  }
+
+  std::string sparse;
+  if (count <= kSparseMaxValue) {
+    sparse = sparseEncode(regs);
+  }
+  if (!sparse.empty() && sparse.size() - kHllHeaderSize <= kHllSparseMaxBytes) {
+    hll = std::move(sparse);
+    return true;
+  }
+
+  // Promote: the value no longer fits a VAL opcode or the body is too big.
+  std::string dense = makeHeader(kEncodingDense);
+  dense.resize(kHllDenseSize, '\0');
+  for (const auto &[i, value] : regs) {
+    denseSet(body(dense), i, value);
+  }
+  hll = std::move(dense);
+  return true;
+}
+
+void hllMergeInto(const std::string &hll, uint8_t *registers) {
+  if (hllIsSparse(hll)) {
+    forEachSparseRun(hll, [&](size_t index, uint8_t value, size_t run) {
+      for (size_t i = index; i < index + run; ++i) {
+        registers[i] = std::max(registers[i], value);
+      }
+    });
+    return;
+  }
+  uint8_t unpacked[kHllRegisters];
+  denseUnpack(body(hll), unpacked);
+  maxBytes(registers, unpacked, kHllRegisters);
+}
+
+uint64_t hllCountRegisters(const uint8_t *registers) {
+  // Ertl's improved raw estimator ("New cardinality estimation algorithms
+  // for HyperLogLog sketches", 2017), as used by Redis since 5.0.
+  int histogram[64] = {0};
+  for (size_t i = 0; i < kHllRegisters; ++i) {
+    ++histogram[registers[i] & 63];
+  }
+
+  double m = kHllRegisters;
+  double z = m * hllTau((m - histogram[kHllQ + 1]) / m);
+  for (int j = kHllQ; j >= 1; --j) {
+    z += histogram[j];
+    z *= 0.5;
+  }
+  z += m * hllSigma(histogram[0] / m);
+  return static_cast<uint64_t>(std::llround(kAlphaInf * m * m / z));
+}
+
+uint64_t hllCount(std::string &hll) {
+  uint8_t *card = reinterpret_cast<uint8_t *>(&hll[8]);
+  if ((card[7] & 0x80) == 0) {
+    uint64_t cached = 0;
+    for (int i = 7; i >= 0; --i) {
+      cached = (cached << 8) | card[i];
+    }
+    return cached;
+  }
+
+  uint8_t registers[kHllRegisters] = {0};
+  hllMergeInto(hll, registers);
+  uint64_t estimate = hllCountRegisters(registers);
+  for (int i = 0; i < 8; ++i) {
+    card[i] = (estimate >> (8 * i)) & 0xff;
+  }
+  return estimate;
+}
+
+std::string hllFromRegisters(const uint8_t *registers) {
+  std::string hll = makeHeader(kEncodingDense);
+  hll.resize(kHllDenseSize, '\0');
+  densePack(registers, body(hll));
+  return hll;
+}
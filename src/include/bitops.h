@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * BitKernel: Implementations of the bitmap and HyperLogLog register
+ * kernels. POPCNT only accelerates popcount(); the rest fall back to scalar.
+ */
+enum class BitKernel { Scalar, POPCNT, AVX2 };
+
+/**
+ * Best kernel supported by the running CPU.
+ */
+BitKernel detectBitKernel();
+
+/**
+ * Kernel used by the overloads without a kernel argument. Defaults to
+ * detectBitKernel(); tests and benchmarks may override it.
+ */
+BitKernel activeBitKernel();
+void setActiveBitKernel(BitKernel kernel);
+
+bool bitKernelSupported(BitKernel kernel);
+const char *bitKernelName(BitKernel kernel);
+
+/**
+ * Number of set bits in data[0, len).
+ */
+size_t popcount(const uint8_t *data, size_t len, BitKernel kernel);
+size_t popcount(const uint8_t *data, size_t len);
+
+enum class BitOp { And, Or, Xor, Not };
+
+/**
+ * dst[i] = dst[i] <op> src[i] for i in [0, len); Not ignores dst and
+ * stores ~src[i].
+ */
+void bitop(BitOp op, uint8_t *dst, const uint8_t *src, size_t len,
+           BitKernel kernel);
+void bitop(BitOp op, uint8_t *dst, const uint8_t *src, size_t len);
+
+/**
+ * dst[i] = max(dst[i], src[i]); merges HyperLogLog registers.
+ */
+void maxBytes(uint8_t *dst, const uint8_t *src, size_t len, BitKernel kernel);
+void maxBytes(uint8_t *dst, const uint8_t *src, size_t len);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * ClientClass: Selects which output buffer limits apply to a client.
+ * Every connection is Normal until pub/sub commands exist.
+ */
+enum class ClientClass { Normal, PubSub };
+
+/**
+ * ClientInfo: Registry entry for one connection, shared between the thread
+ * serving it and CLIENT LIST / CLIENT KILL.
+ */
+struct ClientInfo {
+  uint64_t id = 0;
+  int fd = -1;
+  std::string addr;
+  ClientClass client_class = ClientClass::Normal;
+  std::chrono::steady_clock::time_point created =
+      std::chrono::steady_clock::now();
+
+  // Updated by the thread serving the connection, read by CLIENT LIST.
+  std::atomic<int64_t> last_interaction_ms{0};
+  std::atomic<size_t> query_buffer{0};
+  std::atomic<size_t> output_buffer{0};
+
+  // When the output buffer first went over the soft limit; only touched by
+  // the thread serving the connection.
+  std::chrono::steady_clock::time_point soft_limit_since{};
+
+  void touch();
+};
+
+/**
+ * ClientKillFilter: Which clients CLIENT KILL targets. A filter that was
+ * not given matches every client; `has_id`/`has_addr` record whether it was,
+ * so no value of `id` or `addr` can turn into a wildcard.
+ */
+struct ClientKillFilter {
+  bool has_id = false;
+  uint64_t id = 0;
+  bool has_addr = false;
+  std::string addr;
+  bool skip_self = true;
+};
+
+/**
+ * ClientRegistry: Connected clients, `maxclients` admission and per-client
+ * buffer limits.
+ */
+class ClientRegistry {
+public:
+  // Starts with the ServerConfig defaults.
+  ClientRegistry();
+
+  // Call before accepting connections.
+  void setLimits(const ServerConfig &config);
+
+  // Registers a connection; returns nullptr when maxclients is reached.
+  std::shared_ptr<ClientInfo> add(int fd, std::string addr);
+  // Must run before the connection's fd is closed, so CLIENT KILL never
+  // shuts down a reused descriptor.
+  void remove(uint64_t id);
+  size_t size() const;
+
+  // CLIENT LIST output, one line per client.
+  std::string list() const;
+  // Shuts down matching connections other than `self_id` and returns how
+  // many matched. `matched_self` reports whether the caller matched; the
+  // caller closes itself after replying.
+  size_t kill(const ClientKillFilter &filter, uint64_t self_id,
+              bool &matched_self);
+
+  bool queryBufferExceeded(size_t bytes) const;
+  // Applies the hard and soft output limits for the client's class. Updates
+  // the soft-limit timer, so only the thread holding the client's pending
+  // output may call it.
+  bool outputBufferExceeded(ClientInfo &info, size_t bytes) const;
+  // Hard limit only, without touching the timer: callable from the thread
+  // executing commands while replies are appended.
+  bool outputHardLimitExceeded(const ClientInfo &info, size_t bytes) const;
+  // True while `bytes` are above the soft limit (or the hard one, if there
+  // is no soft limit). io-threads mode stops reading such a client until
+  // its output drains.
+  bool outputBufferOverLimit(const ClientInfo &info, size_t bytes) const;
+
+private:
+  const OutputBufferLimit &outputLimitFor(const ClientInfo &info) const;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, std::shared_ptr<ClientInfo>> clients_;
+  uint64_t next_id_ = 1;
+
+  size_t maxclients_;
+  size_t query_buffer_limit_;
+  OutputBufferLimit normal_output_limit_;
+  OutputBufferLimit pubsub_output_limit_;
+};
+
+extern ClientRegistry client_registry;
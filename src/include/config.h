@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * OutputBufferLimit: Per-class reply backlog limits. A client is closed when
+ * its pending output exceeds `hard_bytes`, or stays above `soft_bytes` for
+ * `soft_seconds`. A value of 0 disables that limit.
+ */
+struct OutputBufferLimit {
+  size_t hard_bytes = 0;
+  size_t soft_bytes = 0;
+  int soft_seconds = 0;
+};
+
+/**
+ * ServerConfig: Listener, threading and client limit options, from a
+ * redis.conf-style file and/or `--name value` command-line options.
+ */
+struct ServerConfig {
+  // Addresses to listen on for TCP; IPv6 addresses contain ':'.
+  std::vector<std::string> bind = {"0.0.0.0"};
+  // 0 disables the TCP listener.
+  int port = 6379;
+  // Empty disables the Unix socket listener.
+  std::string unixsocket;
+  // Octal permissions for the Unix socket; 0 keeps the umask default.
+  mode_t unixsocketperm = 0;
+  int tcp_backlog = 511;
+  bool tcp_nodelay = true;
+  // Keepalive probe interval in seconds; 0 disables keepalive.
+  int tcp_keepalive = 300;
+  // 0 runs one thread per client; N > 0 enables threaded I/O.
+  size_t io_threads = 0;
+  // Connections beyond this are rejected with an error.
+  size_t maxclients = 10000;
+  // Unparsed input a single client may accumulate; 0 disables the limit.
+  size_t client_query_buffer_limit = 1024ULL * 1024 * 1024;
+  OutputBufferLimit normal_output_limit;
+  OutputBufferLimit pubsub_output_limit = {32ULL * 1024 * 1024,
+                                           8ULL * 1024 * 1024, 60};
+};
+
+/**
+ * Parses a memory size such as "1024", "32mb" or "1gb" (k/m/g are powers
+ * of 1000, kb/mb/gb powers of 1024). Throws std::invalid_argument.
+ */
+size_t parseMemorySize(const std::string &value);
+
+/**
+ * Applies one option, e.g. ("port", {"6380"}). Names are case-insensitive.
+ * Throws std::invalid_argument on an unknown option or bad value.
+ */
+void applyConfigOption(ServerConfig &config, const std::string &name,
+                       const std::vector<std::string> &args);
+
+/**
+ * Reads `name value...` lines from a config file; '#' starts a comment.
+ * Throws std::invalid_argument with the offending line on error.
+ */
+void loadConfigFile(ServerConfig &config, const std::string &path);
+
+/**
+ * Parses `redis-server [config-file] [--name value...]`. Command-line
+ * options override the file.
+ */
+ServerConfig parseCommandLine(int argc, char **argv);
@@ -1,17 +1,104 @@
+#pragma once
+
+#include "clients.h"
 #include "store.h"
 
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+/**
+ * ClientState: Per-connection state needed by MULTI/EXEC/WATCH.
+ */
+struct ClientState {
+  bool in_multi = false;
+  // Set when a command was rejected while queueing; EXEC then aborts.
+  bool multi_error = false;
+  std::vector<std::vector<std::string>> queued;
+  // Watched key -> key version observed at WATCH time.
+  std::unordered_map<std::string, uint64_t> watched;
+  // Registry entry; null for connections that are not registered.
+  std::shared_ptr<ClientInfo> info;
+  // Set by CLIENT KILL on this connection: close once the reply is sent.
+  bool close_after_reply = false;
+  // Set once pending output plus the reply being built crossed the hard
+  // output buffer limit: no further commands run, and the connection is
+  // closed without sending the reply.
+  bool output_limit_reached = false;
+};
+
+/**
+ * WatchedKey: Version counter for a key that at least one client watches.
+ * Only watched keys are tracked, so writes to other keys never abort a
+ * transaction and the table stays as small as the set of WATCHed keys.
+ */
+struct WatchedKey {
+  uint64_t version = 0;
+  size_t watchers = 0;
+};
+
 extern std::unordered_map<std::string, StoreValue> store;
+extern std::unordered_map<std::string, WatchedKey> watched_keys;
 extern std::mutex store_mutex;
 
-void handleCommand(const std::vector<std::string> &parts, int client_fd);
-void handleSetCommand(const std::vector<std::string> &parts, int client_fd);
-void handleGetCommand(const std::vector<std::string> &parts, int client_fd);
-void handlePpushCommand(const std::vector<std::string> &parts, int client_fd);
-void handleEchoCommand(const std::vector<std::string> &parts, int client_fd);
-void handlePingCommand(int client_fd);
+/**
+ * Runs one command for a client and appends its RESP reply to `reply`.
+ * Takes store_mutex once for commands that touch the keyspace.
+ */
+void handleCommand(const std::vector<std::string> &parts, ClientState &client,
+                   std::string &reply);
+
+/**
+ * Writes a buffered reply to the client socket.
+ */
+void writeReply(int client_fd, const std::string &reply);
+
+/**
+ * Runs one command and appends its RESP reply to `reply`.
+ * The caller must hold store_mutex (or otherwise own the keyspace).
+ * `reply` counts towards the client's hard output buffer limit on top of
+ * info->output_buffer; see ClientState::output_limit_reached.
+ */
+void executeCommand(const std::vector<std::string> &parts, ClientState &client,
+                    std::string &reply);
+
+/**
+ * Drops the client's watches and queued commands, e.g. on disconnect.
+ */
+void releaseClientState(ClientState &client);
+
+void handleSetCommand(const std::vector<std::string> &parts,
+                      std::string &reply);
+void handleGetCommand(const std::vector<std::string> &parts,
+                      std::string &reply);
+void handleSetbitCommand(const std::vector<std::string> &parts,
+                         std::string &reply);
+void handleGetbitCommand(const std::vector<std::string> &parts,
+                         std::string &reply);
+void handleBitcountCommand(const std::vector<std::string> &parts,
+                           std::string &reply);
+void handleBitopCommand(const std::vector<std::string> &parts,
+                        std::string &reply);
+void handleBitposCommand(const std::vector<std::string> &parts,
+                         std::string &reply);
+void handlePfaddCommand(const std::vector<std::string> &parts,
+                        std::string &reply);
+void handlePfcountCommand(const std::vector<std::string> &parts,
+                          std::string &reply);
+void handlePfmergeCommand(const std::vector<std::string> &parts,
+                          std::string &reply);
+void handleEchoCommand(const std::vector<std::string> &parts,
+                       std::string &reply);
+void handlePingCommand(std::string &reply);
+void handleMultiCommand(ClientState &client, std::string &reply);
+void handleExecCommand(ClientState &client, std::string &reply);
+void handleDiscardCommand(ClientState &client, std::string &reply);
+void handleWatchCommand(const std::vector<std::string> &parts,
+                        ClientState &client, std::string &reply);
+void handleUnwatchCommand(ClientState &client, std::string &reply);
+void handleClientCommand(const std::vector<std::string> &parts,
+                         ClientState &client, std::string &reply);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * HyperLogLog sketches stored as plain string values, in the Redis layout:
+ * a 16-byte header ("HYLL", encoding byte, 3 unused bytes, 8-byte cached
+ * cardinality) followed by either a run-length sparse encoding or 16384
+ * packed 6-bit dense registers (12 KB). Sketches start sparse and are
+ * promoted to dense once a register exceeds 32 or the sparse body grows
+ * past kHllSparseMaxBytes.
+ */
+constexpr size_t kHllRegisters = 16384;
+constexpr size_t kHllHeaderSize = 16;
+constexpr size_t kHllDenseSize = kHllHeaderSize + (kHllRegisters * 6 + 7) / 8;
+constexpr size_t kHllSparseMaxBytes = 3000;
+
+/**
+ * Empty sketch in the sparse encoding.
+ */
+std::string hllCreate();
+
+/**
+ * True if value is a well-formed sketch in either encoding.
+ */
+bool isHyperLogLog(const std::string &value);
+
+bool hllIsSparse(const std::string &hll);
+
+/**
+ * Adds element to the sketch, promoting it to dense if needed. Returns true
+ * if a register changed, which also invalidates the cached cardinality.
+ */
+bool hllAdd(std::string &hll, const std::string &element);
+
+/**
+ * Estimated cardinality. Uses the cached value when valid, otherwise
+ * computes it and stores it back in the header.
+ */
+uint64_t hllCount(std::string &hll);
+
+/**
+ * Max-merges the sketch's registers into registers[kHllRegisters], one
+ * byte per register.
+ */
+void hllMergeInto(const std::string &hll, uint8_t *registers);
+
+/**
+ * Cardinality estimate of unpacked registers[kHllRegisters].
+ */
+uint64_t hllCountRegisters(const uint8_t *registers);
+
+/**
+ * Dense sketch holding registers[kHllRegisters].
+ */
+std::string hllFromRegisters(const uint8_t *registers);
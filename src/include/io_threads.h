@@ -0,0 +1,94 @@
+#pragma once
+
+#include "handle_command.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * IOThreadServer: Redis-6-style threaded I/O.
+ *
+ * N I/O threads read client sockets, parse RESP and write replies in
+ * parallel. Parsed commands are handed to a single executor thread, which is
+ * the only thread that touches the keyspace and therefore runs commands
+ * without taking store_mutex. Do not mix with the thread-per-client mode.
+ */
+class IOThreadServer {
+public:
+  explicit IOThreadServer(size_t io_threads);
+  ~IOThreadServer();
+
+  IOThreadServer(const IOThreadServer &) = delete;
+  IOThreadServer &operator=(const IOThreadServer &) = delete;
+
+  // Takes ownership of an accepted socket, registered as `info`, and
+  // assigns it to an I/O thread.
+  void addClient(int client_fd, std::shared_ptr<ClientInfo> info);
+
+private:
+  struct Connection {
+    int fd;
+    std::shared_ptr<ClientInfo> info;
+    std::string input;
+    std::string output;
+    // Set once CLIENT KILL targeted this connection: close when flushed.
+    bool close_when_flushed = false;
+    // Set by the I/O thread after a malformed frame; further input is
+    // dropped while the error reply is on its way.
+    bool protocol_error = false;
+    // Owned by the executor thread.
+    ClientState client;
+  };
+
+  // Work for the executor: commands parsed from one read, or a release
+  // request once the connection has closed.
+  struct Job {
+    std::shared_ptr<Connection> conn;
+    std::vector<std::vector<std::string>> commands;
+    // Non-empty when the read ended in a malformed frame: reply with it
+    // after `commands` and close the connection.
+    std::string protocol_error;
+    size_t io_thread;
+    bool release = false;
+  };
+
+  struct Completion {
+    std::shared_ptr<Connection> conn;
+    std::string reply;
+    bool close_after_reply;
+    // The hard output limit was crossed: close without sending `reply`.
+    bool output_limit_reached;
+  };
+
+  struct IOThread {
+    std::thread thread;
+    int wake_pipe[2] = {-1, -1};
+    std::mutex mutex; // guards pending_clients and completions
+    std::vector<std::shared_ptr<Connection>> pending_clients;
+    std::vector<Completion> completions;
+  };
+
+  void ioLoop(size_t index);
+  void executorLoop();
+  void submit(Job job);
+  void wake(IOThread &io);
+  bool readClient(size_t index, const std::shared_ptr<Connection> &conn);
+  bool flushClient(Connection &conn);
+  void closeClient(size_t index, const std::shared_ptr<Connection> &conn);
+
+  std::vector<std::unique_ptr<IOThread>> io_threads_;
+  std::atomic<size_t> next_io_thread_{0};
+  std::atomic<bool> stopping_{false};
+
+  std::thread executor_;
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_cv_;
+  std::deque<Job> jobs_;
+};
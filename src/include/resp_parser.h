@@ -2,6 +2,7 @@
 
 #include "./resp_datatypes.h"
 
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -23,15 +24,30 @@ struct Token {
   TokenType type;
   std::string value;
   size_t length;
+  // Element count of an ARRAY_BEGIN, parsed once by the tokenizer.
+  long long count;
 
-  Token(TokenType t, const std::string &v, size_t l)
-      : type(t), value(v), length(l) {}
+  Token(TokenType t, const std::string &v, size_t l, long long n = 0)
+      : type(t), value(v), length(l), count(n) {}
 };
 
 /**
- * Tokenizes a RESP input string into tokens.
+ * ProtocolError: Malformed RESP, as opposed to input that is merely
+ * incomplete. Connections reply "-ERR Protocol error: <what>" and close.
  */
-std::vector<Token> tokenizer(const std::string &input);
+class ProtocolError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * Tokenizes the complete top-level RESP frames at the front of `input`,
+ * stopping before a trailing incomplete one. `complete`, if given, receives
+ * the number of bytes those frames span. Throws ProtocolError if `input`
+ * holds a malformed frame.
+ */
+std::vector<Token> tokenizer(const std::string &input,
+                             size_t *complete = nullptr);
 
 class RESPParser {
 public:
@@ -45,19 +61,31 @@ public:
 
   std::shared_ptr<RESPDataType> parser();
   size_t bytesConsumed() const;
+  bool hasMore();
 
 private:
   std::vector<Token> tokens;
   size_t pos;
+  size_t consumed; // Bytes spanned by tokens[0, pos).
 
-  bool hasMore();
   Token &nextToken();
   Token &currentToken();
-  std::shared_ptr<Arrays> parseArray();
+  // Parses the elements of the array whose ARRAY_BEGIN was just consumed.
+  std::shared_ptr<Arrays> parseArray(const Token &begin);
   std::shared_ptr<RESPDataType> parserValue();
   size_t getConsumedBytes() const;
 };
 
+/**
+ * Parses every complete command (an Array of Bulk Strings) at the front of
+ * `input` and appends its arguments to `commands`. Stops at a trailing
+ * incomplete frame and returns the number of bytes consumed. Throws
+ * ProtocolError at a malformed frame, after appending the commands before
+ * it.
+ */
+size_t parseCommands(const std::string &input,
+                     std::vector<std::vector<std::string>> &commands);
+
 /**
  * RESP encoding helpers
  */
@@ -65,3 +93,4 @@ std::string encodeSimpleString(const std::string &s);
 std::string encodeBulkString(const std::string &s);
 std::string encodeNullBulkString();
 std::string encodeErrorString(const std::string &err);
+std::string encodeInteger(long long n);
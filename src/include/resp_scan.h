@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * ScanKernel: Implementations of the RESP framing scan.
+ */
+enum class ScanKernel { Scalar, SSE2, AVX2 };
+
+/**
+ * Best kernel supported by the running CPU.
+ */
+ScanKernel detectScanKernel();
+
+/**
+ * Kernel used by tokenizer(). Defaults to detectScanKernel(); tests and
+ * benchmarks may override it with setActiveScanKernel().
+ */
+ScanKernel activeScanKernel();
+void setActiveScanKernel(ScanKernel kernel);
+
+bool scanKernelSupported(ScanKernel kernel);
+const char *scanKernelName(ScanKernel kernel);
+
+/**
+ * Appends the offset of every "\r\n" in data[0, len) to `positions`, in
+ * increasing order. The offset is that of the '\r'.
+ */
+void findCRLF(const char *data, size_t len, std::vector<size_t> &positions,
+              ScanKernel kernel);
+void findCRLF(const char *data, size_t len, std::vector<size_t> &positions);
+
+/**
+ * Parses a RESP length prefix or integer in [begin, end) without allocating.
+ * Accepts an optional '-' followed by at least one digit. Returns false on
+ * any other byte or on overflow.
+ */
+bool parseRespInteger(const char *begin, const char *end, long long &out);
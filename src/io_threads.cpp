@@ -0,0 +1,355 @@
+#include "include/io_threads.h"
+#include "include/resp_parser.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+} // namespace
+
+IOThreadServer::IOThreadServer(size_t io_threads) {
+  if (io_threads == 0) {
+    io_threads = 1;
+  }
+  for (size_t i = 0; i < io_threads; ++i) {
+    auto io = std::make_unique<IOThread>();
+    if (pipe(io->wake_pipe) != 0) {
+      throw std::runtime_error("Failed to create I/O thread wake pipe");
+    }
+    setNonBlocking(io->wake_pipe[0]);
+    setNonBlocking(io->wake_pipe[1]);
+    io_threads_.push_back(std::move(io));
+  }
+
+  executor_ = std::thread(&IOThreadServer::executorLoop, this);
+  for (size_t i = 0; i < io_threads_.size(); ++i) {
+    io_threads_[i]->thread = std::thread(&IOThreadServer::ioLoop, this, i);
+  }
+}
+
+IOThreadServer::~IOThreadServer() {
+  {
+    // Set under jobs_mutex_ so the executor cannot test the predicate,
+    // miss this notify and then wait forever.
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    stopping_ = true;
+  }
+  jobs_cv_.notify_all();
+  for (auto &io : io_threads_) {
+    wake(*io);
+  }
+  for (auto &io : io_threads_) {
+    io->thread.join();
+  }
+  executor_.join();
+  for (auto &io : io_threads_) {
+    close(io->wake_pipe[0]);
+    close(io->wake_pipe[1]);
+  }
+}
+
+void IOThreadServer::addClient(int client_fd,
+                               std::shared_ptr<ClientInfo> info) {
+  setNonBlocking(client_fd);
+  auto conn = std::make_shared<Connection>();
+  conn->fd = client_fd;
+  conn->info = info;
+  conn->client.info = std::move(info);
+
+  IOThread &io = *io_threads_[next_io_thread_++ % io_threads_.size()];
+  {
+    std::lock_guard<std::mutex> lock(io.mutex);
+    io.pending_clients.push_back(std::move(conn));
+  }
+  wake(io);
+}
+
+void IOThreadServer::wake(IOThread &io) {
+  char byte = 1;
+  // A full pipe already guarantees a pending wakeup, so EAGAIN is fine.
+  (void)!write(io.wake_pipe[1], &byte, 1);
+}
+
+void IOThreadServer::submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  jobs_cv_.notify_one();
+}
+
+void IOThreadServer::ioLoop(size_t index) {
+  IOThread &io = *io_threads_[index];
+  std::vector<std::shared_ptr<Connection>> conns;
+  std::vector<pollfd> fds;
+
+  while (!stopping_) {
+    fds.clear();
+    fds.push_back({io.wake_pipe[0], POLLIN, 0});
+    for (const auto &conn : conns) {
+      // A client whose replies are piling up over its limit is not read
+      // from, so it cannot queue more work until its output drains.
+      short events = 0;
+      if (!client_registry.outputBufferOverLimit(*conn->info,
+                                                 conn->output.size())) {
+        events |= POLLIN;
+      }
+      if (!conn->output.empty()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({conn->fd, events, 0});
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char drain[64];
+      while (read(io.wake_pipe[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+
+    // Socket events: read and parse, or flush replies the kernel could not
+    // take earlier.
+    for (size_t i = 0; i < conns.size(); ++i) {
+      auto &conn = conns[i];
+      short revents = fds[i + 1].revents;
+      if (conn->fd < 0 || revents == 0) {
+        continue;
+      }
+      bool ok = true;
+      if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        ok = readClient(index, conn);
+      }
+      if (ok && (revents & POLLOUT)) {
+        ok = flushClient(*conn);
+      }
+      if (!ok) {
+        closeClient(index, conn);
+      }
+    }
+
+    std::vector<std::shared_ptr<Connection>> added;
+    std::vector<Completion> completions;
+    {
+      std::lock_guard<std::mutex> lock(io.mutex);
+      added.swap(io.pending_clients);
+      completions.swap(io.completions);
+    }
+
+    // Replies from the executor are written here, in parallel with the
+    // other I/O threads.
+    for (auto &done : completions) {
+      if (done.conn->fd < 0) {
+        continue; // Closed while the executor was running its commands.
+      }
+      if (done.output_limit_reached) {
+        std::cerr << "Closing client id=" << done.conn->info->id
+                  << ": output buffer limit reached\n";
+        closeClient(index, done.conn);
+        continue;
+      }
+      done.conn->output += done.reply;
+      done.conn->close_when_flushed |= done.close_after_reply;
+      if (!flushClient(*done.conn)) {
+        closeClient(index, done.conn);
+      }
+    }
+
+    conns.erase(std::remove_if(conns.begin(), conns.end(),
+                               [](const auto &conn) { return conn->fd < 0; }),
+                conns.end());
+    conns.insert(conns.end(), added.begin(), added.end());
+  }
+
+  for (auto &conn : conns) {
+    if (conn->fd >= 0) {
+      client_registry.remove(conn->info->id);
+      close(conn->fd);
+      conn->fd = -1;
+    }
+  }
+}
+
+bool IOThreadServer::readClient(size_t index,
+                                const std::shared_ptr<Connection> &conn_ptr) {
+  Connection &conn = *conn_ptr;
+  // One bounded read per readable event, as Redis does: poll() is level
+  // triggered, so a client with more data pending is simply read again on
+  // the next pass, after the other connections on this thread had a turn.
+  // It also keeps the query buffer check below within one read of the limit.
+  char buffer[16 * 1024];
+  bool open = true;
+  ssize_t n;
+  do {
+    n = read(conn.fd, buffer, sizeof(buffer));
+  } while (n < 0 && errno == EINTR);
+  if (n > 0) {
+    conn.input.append(buffer, n);
+  } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    open = false; // Client disconnected or error occurred.
+  }
+  if (conn.protocol_error) {
+    conn.input.clear(); // Closing once the error reply is flushed.
+    return open;
+  }
+
+  // After a malformed frame the commands before it still run; the executor
+  // then appends the error and the connection closes, as Redis does.
+  std::vector<std::vector<std::string>> commands;
+  std::string protocol_error;
+  try {
+    conn.input.erase(0, parseCommands(conn.input, commands));
+  } catch (const ProtocolError &e) {
+    std::cerr << "Closing client id=" << conn.info->id
+              << ": protocol error: " << e.what() << "\n";
+    protocol_error = e.what();
+    conn.protocol_error = true;
+    conn.input.clear();
+  }
+  conn.info->touch();
+  conn.info->query_buffer = conn.input.size();
+
+  // Whatever is left is an incomplete command. Cap it so a client cannot
+  // grow it without bound, e.g. with a huge unterminated bulk string.
+  if (client_registry.queryBufferExceeded(conn.input.size())) {
+    std::cerr << "Closing client id=" << conn.info->id
+              << ": query buffer limit reached\n";
+    return false;
+  }
+
+  if (!commands.empty() || !protocol_error.empty()) {
+    // The executor drains jobs in FIFO order, so replies for one connection
+    // come back in the order its commands arrived.
+    Job job;
+    job.conn = conn_ptr;
+    job.commands = std::move(commands);
+    job.protocol_error = std::move(protocol_error);
+    job.io_thread = index;
+    submit(std::move(job));
+  }
+  return open;
+}
+
+bool IOThreadServer::flushClient(Connection &conn) {
+  size_t sent = 0;
+  while (sent < conn.output.size()) {
+    ssize_t n = send(conn.fd, conn.output.data() + sent,
+                     conn.output.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += static_cast<size_t>(n);
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break; // Wait for POLLOUT.
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+  conn.output.erase(0, sent);
+  conn.info->output_buffer = conn.output.size();
+
+  // Replies pile up here when a client pipelines without reading them.
+  if (client_registry.outputBufferExceeded(*conn.info, conn.output.size())) {
+    std::cerr << "Closing client id=" << conn.info->id
+              << ": output buffer limit reached\n";
+    return false;
+  }
+  return !(conn.close_when_flushed && conn.output.empty());
+}
+
+void IOThreadServer::closeClient(size_t index,
+                                 const std::shared_ptr<Connection> &conn) {
+  // Unregister first so CLIENT KILL cannot touch the fd once it is closed.
+  client_registry.remove(conn->info->id);
+  close(conn->fd);
+  conn->fd = -1;
+  conn->input.clear();
+  conn->output.clear();
+
+  Job job;
+  job.conn = conn;
+  job.io_thread = index;
+  job.release = true;
+  submit(std::move(job));
+}
+
+void IOThreadServer::executorLoop() {
+  std::deque<Job> batch;
+  std::vector<std::vector<Completion>> outgoing(io_threads_.size());
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      jobs_cv_.wait(lock, [&] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      batch.swap(jobs_);
+    }
+
+    for (auto &job : batch) {
+      if (job.release) {
+        // Only this thread touches the keyspace; the lock taken here is
+        // uncontended and off the per-command path.
+        releaseClientState(job.conn->client);
+        continue;
+      }
+      // executeCommand() checks the hard output limit as the reply grows
+      // (on top of what the connection still holds) and stops the client
+      // once it is crossed, so a pipeline of large replies cannot pile up.
+      ClientState &client = job.conn->client;
+      std::string reply;
+      for (const auto &parts : job.commands) {
+        executeCommand(parts, client, reply);
+        if (client.output_limit_reached) {
+          reply.clear();
+          break;
+        }
+      }
+      bool close_after_reply = client.close_after_reply;
+      if (!job.protocol_error.empty()) {
+        reply += encodeErrorString("ERR Protocol error: " + job.protocol_error);
+        close_after_reply = true;
+      }
+      outgoing[job.io_thread].push_back({job.conn, std::move(reply),
+                                         close_after_reply,
+                                         client.output_limit_reached});
+    }
+    batch.clear();
+
+    // One lock and one wakeup per I/O thread for the whole batch.
+    for (size_t i = 0; i < outgoing.size(); ++i) {
+      if (outgoing[i].empty()) {
+        continue;
+      }
+      IOThread &io = *io_threads_[i];
+      {
+        std::lock_guard<std::mutex> lock(io.mutex);
+        for (auto &done : outgoing[i]) {
+          io.completions.push_back(std::move(done));
+        }
+      }
+      outgoing[i].clear();
+      wake(io);
+    }
+  }
+}
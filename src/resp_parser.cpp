@@ -1,89 +1,224 @@
 #include "./include/resp_parser.h"
+#include "./include/resp_scan.h"
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
-std::vector<Token> tokenizer(const std::string &input) {
-  std::vector<Token> tokens;
+namespace {
+
+// Longest header line accepted without its CRLF, as Redis caps inline and
+// multibulk count lines; beyond it the client is not speaking RESP.
+constexpr size_t kMaxHeaderLine = 64 * 1024;
+
+// Appends the tokens of the complete top-level frames at the front of
+// `input` to `tokens` and returns the bytes they span. A malformed frame
+// stops the scan like an incomplete one, and `error` then describes it, so
+// callers can still act on the frames before it.
+size_t tokenizeFrames(const std::string &input, std::vector<Token> &tokens,
+                      std::string &error) {
   size_t pos = 0;
 
-  while (pos < input.size()) {
-    size_t start = pos;
-    char c = input[pos];
-    switch (c) {
-    case '+': { // Simple String
-      size_t end = input.find("\r\n", pos);
-      std::string str = input.substr(pos + 1, end - (pos + 1));
-      tokens.emplace_back(TokenType::STRING, str, end - start + 2);
-      pos = end + 2;
-      break;
-    }
-    case '-': { // Error
-      size_t end = input.find("\r\n", pos);
-      std::string str = input.substr(pos + 1, end - (pos + 1));
-      tokens.emplace_back(TokenType::ERROR, str, end - start + 2);
-      pos = end + 2;
-      break;
+  // CRLFs are located by the SIMD framing kernel in fixed-size blocks, on
+  // demand from lineEnd(). A header that starts past the scanned region
+  // (i.e. after a skipped bulk payload) restarts the scan there, so payload
+  // bytes are never scanned and an incomplete bulk string is detected right
+  // after its header instead of after a scan of the whole buffer.
+  constexpr size_t kScanBlock = 4096;
+  thread_local std::vector<size_t> crlf;
+  crlf.clear();
+  size_t next = 0;    // first entry of `crlf` not yet passed
+  size_t scanned = 0; // every CRLF starting before this offset is in `crlf`
+  // Returns the offset of the first CRLF at or after `from`, or npos if the
+  // line is not complete yet.
+  auto lineEnd = [&](size_t from) {
+    if (from > scanned) {
+      crlf.clear();
+      next = 0;
+      scanned = from;
     }
-    case ':': { // Integer
-      size_t end = input.find("\r\n", pos);
-      std::string num = input.substr(pos + 1, end - (pos + 1));
-      tokens.emplace_back(TokenType::INTEGER, num, end - start + 2);
-      pos = end + 2;
-      break;
+    while (true) {
+      while (next < crlf.size() && crlf[next] < from) {
+        ++next;
+      }
+      if (next < crlf.size()) {
+        return crlf[next];
+      }
+      if (scanned >= input.size()) {
+        return std::string::npos;
+      }
+      crlf.clear();
+      next = 0;
+      size_t block_end = std::min(input.size(), scanned + kScanBlock);
+      findCRLF(input.data() + scanned, block_end - scanned, crlf);
+      for (size_t &offset : crlf) {
+        offset += scanned;
+      }
+      // Blocks overlap by one byte so a CRLF split across the boundary is
+      // found by the next block; one found in this block ends before it.
+      scanned = block_end == input.size() ? block_end : block_end - 1;
     }
-    case ',': { // Double
-      size_t end = input.find("\r\n", pos);
-      std::string num = input.substr(pos + 1, end - (pos + 1));
-      tokens.emplace_back(TokenType::DOUBLE, num, end - start + 2);
-      pos = end + 2;
-      break;
+  };
+  auto lineInteger = [&](size_t start, size_t end) {
+    long long n;
+    if (!parseRespInteger(input.data() + start + 1, input.data() + end, n)) {
+      throw ProtocolError("invalid length");
     }
-    case '_': { // Null
-      tokens.emplace_back(TokenType::NULLs, "", 3);
-      pos += 3; // "_\r\n"
-      break;
+    return n;
+  };
+
+  // Elements still expected by each open array, innermost last. A value
+  // that closes the outermost array ends a top-level frame; only whole
+  // frames are returned, so a read that ends mid-frame still yields the
+  // frames before it.
+  std::vector<long long> open_arrays;
+  size_t frame_tokens = tokens.size();
+  size_t frame_bytes = 0;
+  auto valueDone = [&] {
+    while (!open_arrays.empty() && --open_arrays.back() == 0) {
+      open_arrays.pop_back();
     }
-    case '#': { // Boolean
-      char val = input[pos + 1];
-      tokens.emplace_back(TokenType::STRING, val == 't' ? "true" : "false", 3);
-      pos += 3; // "#t\r\n" or "#f\r\n"
-      break;
+    if (open_arrays.empty()) {
+      frame_tokens = tokens.size();
+      frame_bytes = pos;
     }
-    case '$': { // Bulk String
-      size_t end = input.find("\r\n", pos);
-      int len = std::stoi(input.substr(pos + 1, end - (pos + 1)));
-      pos = end + 2;
-      if (len == -1) {
-        tokens.emplace_back(TokenType::NULLs, "", end - start + 2);
-      } else {
-        if (input.size() < pos + len + 2 ||
-            input.substr(pos + len, 2) != "\r\n") {
-          throw std::runtime_error("Bulk string length mismatch");
+  };
+
+  try {
+    while (pos < input.size()) {
+      size_t start = pos;
+      char c = input[pos];
+      switch (c) {
+      case '+':
+      case '-':
+      case ':':
+      case ',':
+      case '_':
+      case '#':
+      case '$':
+      case '*':
+        break;
+      default:
+        throw ProtocolError("invalid type '" + std::string(1, c) + "'");
+      }
+      // Every type starts with a header line; wait for all of it.
+      size_t end = lineEnd(pos);
+      if (end == std::string::npos) {
+        if (input.size() - pos > kMaxHeaderLine) {
+          throw ProtocolError("too big header line");
         }
-        std::string str = input.substr(pos, len);
-        tokens.emplace_back(TokenType::BULKSTRING, str,
+        break;
+      }
+
+      switch (c) {
+      case '+': { // Simple String
+        tokens.emplace_back(TokenType::STRING,
+                            input.substr(pos + 1, end - (pos + 1)),
+                            end - start + 2);
+        pos = end + 2;
+        break;
+      }
+      case '-': { // Error
+        tokens.emplace_back(TokenType::ERROR,
+                            input.substr(pos + 1, end - (pos + 1)),
+                            end - start + 2);
+        pos = end + 2;
+        break;
+      }
+      case ':': { // Integer
+        tokens.emplace_back(TokenType::INTEGER,
+                            input.substr(pos + 1, end - (pos + 1)),
+                            end - start + 2);
+        pos = end + 2;
+        break;
+      }
+      case ',': { // Double
+        tokens.emplace_back(TokenType::DOUBLE,
+                            input.substr(pos + 1, end - (pos + 1)),
+                            end - start + 2);
+        pos = end + 2;
+        break;
+      }
+      case '_': { // Null
+        if (end != pos + 1) {
+          throw ProtocolError("invalid null");
+        }
+        tokens.emplace_back(TokenType::NULLs, "", 3);
+        pos += 3; // "_\r\n"
+        break;
+      }
+      case '#': { // Boolean
+        if (end != pos + 2) {
+          throw ProtocolError("invalid boolean");
+        }
+        char val = input[pos + 1];
+        tokens.emplace_back(TokenType::STRING, val == 't' ? "true" : "false",
+                            4);
+        pos += 4; // "#t\r\n" or "#f\r\n"
+        break;
+      }
+      case '$': { // Bulk String
+        long long len = lineInteger(pos, end);
+        size_t payload = end + 2;
+        if (len == -1) {
+          tokens.emplace_back(TokenType::NULLs, "", end - start + 2);
+          pos = payload;
+          break;
+        }
+        if (len < 0) {
+          throw ProtocolError("invalid bulk length");
+        }
+        if (input.size() - payload < static_cast<size_t>(len) + 2) {
+          break; // Payload not complete yet; `pos` stays on the header.
+        }
+        if (input[payload + len] != '\r' || input[payload + len + 1] != '\n') {
+          throw ProtocolError("invalid bulk length");
+        }
+        tokens.emplace_back(TokenType::BULKSTRING, input.substr(payload, len),
                             end - start + 2 + len + 2);
-        pos += len + 2;
+        pos = payload + len + 2;
+        break;
       }
-      break;
-    }
-    case '*': { // Array
-      size_t end = input.find("\r\n", pos);
-      int num = std::stoi(input.substr(pos + 1, end - (pos + 1)));
-      pos = end + 2;
-      tokens.emplace_back(TokenType::ARRAY_BEGIN, std::to_string(num),
-                          end - start + 2);
-      break;
-    }
-    default:
-      throw std::runtime_error("Invalid RESP type: " + std::string(1, c));
+      case '*': { // Array
+        long long num = lineInteger(pos, end);
+        pos = end + 2;
+        tokens.emplace_back(TokenType::ARRAY_BEGIN, "", end - start + 2, num);
+        if (num > 0) {
+          open_arrays.push_back(num);
+          continue; // Its elements complete it.
+        }
+        break;
+      }
+      }
+      if (pos == start) {
+        break; // Incomplete bulk payload.
+      }
+      valueDone();
     }
+  } catch (const ProtocolError &e) {
+    error = e.what();
+  }
+
+  tokens.erase(tokens.begin() + frame_tokens, tokens.end());
+  return frame_bytes;
+}
+
+} // namespace
+
+std::vector<Token> tokenizer(const std::string &input, size_t *complete) {
+  std::vector<Token> tokens;
+  std::string error;
+  size_t bytes = tokenizeFrames(input, tokens, error);
+  if (!error.empty()) {
+    throw ProtocolError(error);
+  }
+  if (complete) {
+    *complete = bytes;
   }
   return tokens;
 }
 
 RESPParser::RESPParser(const std::string &string)
-    : tokens(tokenizer(string)), pos(0) {}
+    : tokens(tokenizer(string)), pos(0), consumed(0) {}
 
 std::shared_ptr<RESPDataType> RESPParser::parser() {
   if (pos >= tokens.size()) {
@@ -94,13 +229,7 @@ std::shared_ptr<RESPDataType> RESPParser::parser() {
 
 size_t RESPParser::bytesConsumed() const { return getConsumedBytes(); }
 
-size_t RESPParser::getConsumedBytes() const {
-  size_t b = 0;
-  for (size_t i = 0; i < pos; ++i) {
-    b += tokens[i].length;
-  }
-  return b;
-}
+size_t RESPParser::getConsumedBytes() const { return consumed; }
 
 bool RESPParser::hasMore() { return pos < tokens.size(); }
 
@@ -108,6 +237,9 @@ Token &RESPParser::nextToken() {
   if (!hasMore()) {
     throw std::runtime_error("Unexpected end of input");
   }
+  // Kept as a running total so bytesConsumed() after every pipelined
+  // command stays O(1) instead of re-adding every token from the start.
+  consumed += tokens[pos].length;
   return tokens[pos++];
 }
 
@@ -118,16 +250,10 @@ Token &RESPParser::currentToken() {
   return tokens[pos];
 }
 
-std::shared_ptr<Arrays> RESPParser::parseArray() {
+std::shared_ptr<Arrays> RESPParser::parseArray(const Token &begin) {
   auto array = std::make_shared<Arrays>();
 
-  Token &begin = nextToken();
-  if (begin.type != TokenType::ARRAY_BEGIN) {
-    throw std::runtime_error("Expected ARRAY_BEGIN");
-  }
-
-  int num = std::stoi(begin.value);
-  for (int i = 0; i < num; i++) {
+  for (long long i = 0; i < begin.count; i++) {
     array->values.emplace_back(parserValue());
   }
   return array;
@@ -149,13 +275,48 @@ std::shared_ptr<RESPDataType> RESPParser::parserValue() {
   case NULLs:
     return std::make_shared<Null>();
   case ARRAY_BEGIN:
-    pos--;
-    return parseArray();
+    return parseArray(tok);
   default:
     throw std::runtime_error("Unsupported token in parserValue");
   }
 }
 
+size_t parseCommands(const std::string &input,
+                     std::vector<std::vector<std::string>> &commands) {
+  // Tokenize once and walk the frames, rather than re-tokenizing the
+  // remaining buffer for every pipelined command. The tokens cover only
+  // complete frames, so a trailing partial command (the rest arrives with
+  // the next read) never holds back the ones before it.
+  std::vector<Token> tokens;
+  std::string error;
+  size_t complete = tokenizeFrames(input, tokens, error);
+
+  // Requests are arrays of bulk strings, as Redis requires of multibulk
+  // requests; an empty or null array is skipped.
+  for (size_t i = 0; i < tokens.size();) {
+    const Token &begin = tokens[i++];
+    if (begin.type != TokenType::ARRAY_BEGIN) {
+      throw ProtocolError("expected '*'");
+    }
+    std::vector<std::string> parts;
+    parts.reserve(begin.count > 0 ? begin.count : 0);
+    for (long long n = 0; n < begin.count; ++n) {
+      Token &arg = tokens[i++];
+      if (arg.type != TokenType::BULKSTRING) {
+        throw ProtocolError("expected '$'");
+      }
+      parts.push_back(std::move(arg.value));
+    }
+    if (!parts.empty()) {
+      commands.push_back(std::move(parts));
+    }
+  }
+  if (!error.empty()) {
+    throw ProtocolError(error);
+  }
+  return complete;
+}
+
 std::string encodeSimpleString(const std::string &s) {
   return "+" + s + "\r\n";
 }
@@ -169,3 +330,7 @@ std::string encodeNullBulkString() { return "$-1\r\n"; }
 std::string encodeErrorString(const std::string &err) {
   return "-" + err + "\r\n";
 }
+
+std::string encodeInteger(long long n) {
+  return ":" + std::to_string(n) + "\r\n";
+}
@@ -0,0 +1,181 @@
+#include "./include/resp_scan.h"
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESP_SCAN_X86 1
+#endif
+
+namespace {
+
+void findCRLFScalar(const char *data, size_t begin, size_t len,
+                    std::vector<size_t> &positions) {
+  if (len < 2) {
+    return;
+  }
+  // memchr skips the bytes between carriage returns quickly.
+  size_t i = begin;
+  while (i + 1 < len) {
+    const void *cr = std::memchr(data + i, '\r', len - 1 - i);
+    if (!cr) {
+      return;
+    }
+    i = static_cast<const char *>(cr) - data;
+    if (data[i + 1] == '\n') {
+      positions.push_back(i);
+    }
+    ++i;
+  }
+}
+
+#ifdef RESP_SCAN_X86
+
+// Each step compares a block against '\r' and the same block shifted by one
+// byte against '\n'; the AND of the two masks marks every CRLF in the block.
+__attribute__((target("sse2"))) void
+findCRLFSSE2(const char *data, size_t len, std::vector<size_t> &positions) {
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 17 <= len; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf))));
+    while (mask) {
+      positions.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  findCRLFScalar(data, i, len, positions);
+}
+
+__attribute__((target("avx2"))) void
+findCRLFAVX2(const char *data, size_t len, std::vector<size_t> &positions) {
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 33 <= len; i += 32) {
+    __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 1));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+    while (mask) {
+      positions.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  findCRLFScalar(data, i, len, positions);
+}
+
+#endif
+
+std::atomic<ScanKernel> active_kernel{detectScanKernel()};
+
+} // namespace
+
+ScanKernel detectScanKernel() {
+#ifdef RESP_SCAN_X86
+  // Also runs from a static initializer, possibly before libgcc's own.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanKernel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ScanKernel::SSE2;
+  }
+#endif
+  return ScanKernel::Scalar;
+}
+
+ScanKernel activeScanKernel() {
+  return active_kernel.load(std::memory_order_relaxed);
+}
+
+void setActiveScanKernel(ScanKernel kernel) {
+  if (scanKernelSupported(kernel)) {
+    active_kernel.store(kernel, std::memory_order_relaxed);
+  }
+}
+
+bool scanKernelSupported(ScanKernel kernel) {
+  switch (kernel) {
+  case ScanKernel::Scalar:
+    return true;
+#ifdef RESP_SCAN_X86
+  case ScanKernel::SSE2:
+    return __builtin_cpu_supports("sse2");
+  case ScanKernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *scanKernelName(ScanKernel kernel) {
+  switch (kernel) {
+  case ScanKernel::Scalar:
+    return "scalar";
+  case ScanKernel::SSE2:
+    return "sse2";
+  case ScanKernel::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+void findCRLF(const char *data, size_t len, std::vector<size_t> &positions,
+              ScanKernel kernel) {
+  switch (kernel) {
+#ifdef RESP_SCAN_X86
+  case ScanKernel::SSE2:
+    findCRLFSSE2(data, len, positions);
+    return;
+  case ScanKernel::AVX2:
+    findCRLFAVX2(data, len, positions);
+    return;
+#endif
+  default:
+    findCRLFScalar(data, 0, len, positions);
+    return;
+  }
+}
+
+void findCRLF(const char *data, size_t len, std::vector<size_t> &positions) {
+  findCRLF(data, len, positions, activeScanKernel());
+}
+
+bool parseRespInteger(const char *begin, const char *end, long long &out) {
+  bool negative = begin < end && *begin == '-';
+  const char *p = begin + negative;
+  if (p == end) {
+    return false;
+  }
+
+  unsigned long long value = 0;
+  for (; p < end; ++p) {
+    unsigned digit = static_cast<unsigned char>(*p) - '0';
+    if (digit > 9 || __builtin_mul_overflow(value, 10ULL, &value) ||
+        __builtin_add_overflow(value, digit, &value)) {
+      return false;
+    }
+  }
+
+  // The magnitude of LLONG_MIN is one more than LLONG_MAX.
+  const unsigned long long limit =
+      static_cast<unsigned long long>(std::numeric_limits<long long>::max()) +
+      negative;
+  if (value > limit) {
+    return false;
+  }
+  out = negative ? static_cast<long long>(0 - value)
+                 : static_cast<long long>(value);
+  return true;
+}
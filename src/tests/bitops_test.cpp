@@ -0,0 +1,155 @@
+#include "../include/bitops.h"
+#include "command_test_util.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+std::vector<uint8_t> randomBytes(size_t len, std::mt19937 &rng) {
+  std::vector<uint8_t> bytes(len);
+  for (auto &b : bytes)
+    b = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+class BitopsTest : public CommandTest {};
+
+} // namespace
+
+TEST_F(BitopsTest, KernelsMatchScalar) {
+  std::mt19937 rng(31);
+  // Lengths around the 8-byte word and 32-byte vector boundaries, plus one
+  // long enough to cross the AVX2 popcount's 8-block accumulator flush.
+  for (size_t len : {0, 1, 7, 8, 31, 32, 33, 255, 256, 1000, 4099}) {
+    auto a = randomBytes(len, rng);
+    auto b = randomBytes(len, rng);
+    size_t expected = popcount(a.data(), len, BitKernel::Scalar);
+
+    for (auto kernel : {BitKernel::POPCNT, BitKernel::AVX2}) {
+      if (!bitKernelSupported(kernel))
+        continue;
+      SCOPED_TRACE(bitKernelName(kernel));
+      EXPECT_EQ(popcount(a.data(), len, kernel), expected) << "len " << len;
+
+      for (auto op : {BitOp::And, BitOp::Or, BitOp::Xor, BitOp::Not}) {
+        auto scalar = a;
+        auto vector = a;
+        bitop(op, scalar.data(), b.data(), len, BitKernel::Scalar);
+        bitop(op, vector.data(), b.data(), len, kernel);
+        EXPECT_EQ(vector, scalar) << "len " << len;
+      }
+
+      auto scalar = a;
+      auto vector = a;
+      maxBytes(scalar.data(), b.data(), len, BitKernel::Scalar);
+      maxBytes(vector.data(), b.data(), len, kernel);
+      EXPECT_EQ(vector, scalar) << "len " << len;
+    }
+  }
+}
+
+TEST_F(BitopsTest, SetbitAndGetbit) {
+  ClientState client;
+  EXPECT_EQ(run(client, {"SETBIT", "b", "7", "1"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"SETBIT", "b", "7", "1"}), ":1\r\n");
+  EXPECT_EQ(run(client, {"GET", "b"}), "$1\r\n\x01\r\n");
+  EXPECT_EQ(run(client, {"GETBIT", "b", "7"}), ":1\r\n");
+  EXPECT_EQ(run(client, {"GETBIT", "b", "6"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"GETBIT", "b", "1000"}), ":0\r\n");
+
+  // Growing the string zero-fills the new bytes.
+  EXPECT_EQ(run(client, {"SETBIT", "b", "23", "1"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"GET", "b"}), std::string("$3\r\n\x01\x00\x01\r\n", 9));
+  EXPECT_EQ(run(client, {"SETBIT", "b", "7", "0"}), ":1\r\n");
+
+  EXPECT_EQ(run(client, {"SETBIT", "b", "-1", "1"}),
+            "-ERR bit offset is not an integer or out of range\r\n");
+  EXPECT_EQ(run(client, {"SETBIT", "b", "4294967296", "1"}),
+            "-ERR bit offset is not an integer or out of range\r\n");
+  EXPECT_EQ(run(client, {"SETBIT", "b", "1", "2"}),
+            "-ERR bit is not an integer or out of range\r\n");
+}
+
+TEST_F(BitopsTest, Bitcount) {
+  ClientState client;
+  run(client, {"SET", "s", "foobar"});
+  EXPECT_EQ(run(client, {"BITCOUNT", "s"}), ":26\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "0", "0"}), ":4\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "1", "1"}), ":6\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "1", "1", "BYTE"}), ":6\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "5", "30", "BIT"}), ":17\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "-2", "-1"}), ":7\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "4", "2"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "missing"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "s", "0"}), "-ERR syntax error\r\n");
+}
+
+TEST_F(BitopsTest, Bitop) {
+  ClientState client;
+  run(client, {"SET", "k1", "foobar"});
+  run(client, {"SET", "k2", "abcdef"});
+  EXPECT_EQ(run(client, {"BITOP", "AND", "dest", "k1", "k2"}), ":6\r\n");
+  EXPECT_EQ(run(client, {"GET", "dest"}), "$6\r\n`bc`ab\r\n");
+  EXPECT_EQ(run(client, {"BITOP", "OR", "dest", "k1", "k2"}), ":6\r\n");
+  EXPECT_EQ(run(client, {"GET", "dest"}), "$6\r\ngoofev\r\n");
+
+  // Shorter and missing sources count as zero bytes.
+  run(client, {"SET", "short", "\xff"});
+  EXPECT_EQ(run(client, {"BITOP", "AND", "dest", "k1", "short"}), ":6\r\n");
+  EXPECT_EQ(run(client, {"GET", "dest"}),
+            std::string("$6\r\nf\0\0\0\0\0\r\n", 12));
+  EXPECT_EQ(run(client, {"BITOP", "XOR", "dest", "k1", "k1", "missing"}),
+            ":6\r\n");
+  EXPECT_EQ(run(client, {"BITCOUNT", "dest"}), ":0\r\n");
+
+  EXPECT_EQ(run(client, {"BITOP", "NOT", "dest", "short"}), ":1\r\n");
+  EXPECT_EQ(run(client, {"GET", "dest"}), std::string("$1\r\n\0\r\n", 7));
+  EXPECT_EQ(run(client, {"BITOP", "NOT", "dest", "k1", "k2"}),
+            "-ERR BITOP NOT must be called with a single source key.\r\n");
+
+  // An empty result deletes the destination.
+  EXPECT_EQ(run(client, {"BITOP", "OR", "dest", "missing"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"GET", "dest"}), "$-1\r\n");
+}
+
+TEST_F(BitopsTest, Bitpos) {
+  ClientState client;
+  run(client, {"SET", "s", std::string("\xff\xf0\x00", 3)});
+  EXPECT_EQ(run(client, {"BITPOS", "s", "0"}), ":12\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "s", "1", "2"}), ":-1\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "s", "0", "2", "-1", "BYTE"}), ":16\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "s", "1", "7", "15", "BIT"}), ":7\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "s", "0", "7", "11", "BIT"}), ":-1\r\n");
+
+  // All ones: without an explicit end the first clear bit is past the end.
+  run(client, {"SET", "ones", std::string(20, '\xff')});
+  EXPECT_EQ(run(client, {"BITPOS", "ones", "0"}), ":160\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "ones", "0", "0", "-1"}), ":-1\r\n");
+
+  // Long zero runs go through the word-at-a-time skip.
+  std::string sparse(100, '\0');
+  sparse[77] = '\x04';
+  run(client, {"SET", "sparse", sparse});
+  EXPECT_EQ(run(client, {"BITPOS", "sparse", "1"}), ":621\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "sparse", "1", "78"}), ":-1\r\n");
+
+  EXPECT_EQ(run(client, {"BITPOS", "missing", "0"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"BITPOS", "missing", "1"}), ":-1\r\n");
+}
+
+TEST_F(BitopsTest, SetbitKeepsExpiryAndTouchesWatch) {
+  ClientState client;
+  ClientState watcher;
+  run(client, {"SET", "b", "x", "PX", "100000"});
+  run(client, {"SETBIT", "b", "0", "1"});
+  {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    EXPECT_TRUE(store.at("b").has_expiry);
+  }
+
+  run(watcher, {"WATCH", "b"});
+  run(client, {"SETBIT", "b", "1", "1"});
+  run(watcher, {"MULTI"});
+  run(watcher, {"GETBIT", "b", "1"});
+  EXPECT_EQ(run(watcher, {"EXEC"}), "*-1\r\n");
+}
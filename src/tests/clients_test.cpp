@@ -0,0 +1,235 @@
+#include "../include/clients.h"
+#include "../include/handle_command.h"
+#include "../include/io_threads.h"
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST(ClientRegistryTest, MaxClients) {
+  ClientRegistry registry;
+  ServerConfig config;
+  config.maxclients = 2;
+  registry.setLimits(config);
+
+  auto a = registry.add(-1, "a:1");
+  auto b = registry.add(-1, "b:1");
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(registry.add(-1, "c:1"), nullptr);
+
+  registry.remove(a->id);
+  EXPECT_NE(registry.add(-1, "c:1"), nullptr);
+}
+
+TEST(ClientRegistryTest, OutputLimits) {
+  ClientRegistry registry;
+  ServerConfig config;
+  config.normal_output_limit = {1000, 100, 0};
+  registry.setLimits(config);
+  auto info = registry.add(-1, "a:1");
+
+  EXPECT_FALSE(registry.outputBufferExceeded(*info, 50));
+  EXPECT_TRUE(registry.outputBufferExceeded(*info, 1001));
+  // Soft limit with a zero grace period trips as soon as it is crossed.
+  EXPECT_TRUE(registry.outputBufferExceeded(*info, 200));
+
+  config.normal_output_limit = {0, 100, 60};
+  registry.setLimits(config);
+  info->soft_limit_since = {};
+  EXPECT_FALSE(registry.outputBufferExceeded(*info, 200));
+  EXPECT_FALSE(registry.outputBufferExceeded(*info, 200));
+  // Dropping back under the soft limit resets the timer.
+  EXPECT_FALSE(registry.outputBufferExceeded(*info, 10));
+  EXPECT_EQ(info->soft_limit_since, std::chrono::steady_clock::time_point{});
+}
+
+TEST(ClientRegistryTest, KillById) {
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+  ClientState killer;
+  killer.info = client_registry.add(-1, "killer:1");
+  auto victim = client_registry.add(sv[0], "victim:1");
+
+  std::string reply;
+  executeCommand({"CLIENT", "KILL", "ID", std::to_string(victim->id)}, killer,
+                 reply);
+  EXPECT_EQ(reply, ":1\r\n");
+
+  // The victim's end was shut down, so its peer sees EOF.
+  char byte;
+  EXPECT_EQ(read(sv[1], &byte, 1), 0);
+
+  reply.clear();
+  executeCommand({"CLIENT", "KILL", "nobody:1"}, killer, reply);
+  EXPECT_EQ(reply, "-ERR No such client\r\n");
+
+  client_registry.remove(victim->id);
+  client_registry.remove(killer.info->id);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(ClientRegistryTest, KillRejectsNonPositiveId) {
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+  ClientState killer;
+  killer.info = client_registry.add(-1, "killer:1");
+  auto bystander = client_registry.add(sv[0], "bystander:1");
+
+  // Neither may be read as "no ID filter" (or wrap to a huge ID).
+  for (const char *id : {"0", "-1", "abc"}) {
+    std::string reply;
+    executeCommand({"CLIENT", "KILL", "ID", id}, killer, reply);
+    EXPECT_EQ(reply, "-ERR client-id should be greater than 0\r\n") << id;
+  }
+
+  // The bystander's connection is still open.
+  char byte = 'x';
+  ASSERT_EQ(write(sv[0], &byte, 1), 1);
+  EXPECT_EQ(read(sv[1], &byte, 1), 1);
+
+  client_registry.remove(bystander->id);
+  client_registry.remove(killer.info->id);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(ClientRegistryTest, QueryBufferLimitClosesConnection) {
+  ServerConfig config;
+  config.client_query_buffer_limit = 1024;
+  client_registry.setLimits(config);
+
+  {
+    IOThreadServer server(1);
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    server.addClient(sv[0], client_registry.add(sv[0], "big:1"));
+
+    // An unterminated bulk string keeps growing the query buffer.
+    std::string header = "*2\r\n$3\r\nGET\r\n$100000\r\n";
+    std::string filler(4096, 'x');
+    ASSERT_GT(write(sv[1], header.data(), header.size()), 0);
+    ASSERT_GT(write(sv[1], filler.data(), filler.size()), 0);
+
+    char byte;
+    EXPECT_EQ(read(sv[1], &byte, 1), 0);
+    close(sv[1]);
+  }
+  client_registry.setLimits(ServerConfig{});
+}
+
+TEST(ClientRegistryTest, HardOutputLimitStopsExecution) {
+  ServerConfig config;
+  config.normal_output_limit = {1000, 0, 0};
+  client_registry.setLimits(config);
+
+  ClientState client;
+  client.info = client_registry.add(-1, "big:1");
+  auto run = [&](const std::vector<std::string> &parts, std::string &reply) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    executeCommand(parts, client, reply);
+  };
+
+  std::string reply;
+  run({"SET", "limit:big", std::string(600, 'v')}, reply);
+  run({"GET", "limit:big"}, reply);
+  EXPECT_FALSE(client.output_limit_reached);
+
+  // The second copy crosses 1000 bytes; nothing runs after that.
+  run({"GET", "limit:big"}, reply);
+  EXPECT_TRUE(client.output_limit_reached);
+  size_t size = reply.size();
+  run({"GET", "limit:big"}, reply);
+  EXPECT_EQ(reply.size(), size);
+
+  // Bytes the connection still holds count towards the limit too.
+  ClientState pending;
+  pending.info = client_registry.add(-1, "pending:1");
+  pending.info->output_buffer = 900;
+  std::string small;
+  {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    executeCommand({"GET", "limit:big"}, pending, small);
+  }
+  EXPECT_TRUE(pending.output_limit_reached);
+
+  client_registry.remove(client.info->id);
+  client_registry.remove(pending.info->id);
+  client_registry.setLimits(ServerConfig{});
+}
+
+TEST(ClientRegistryTest, HardOutputLimitKeepsExecAtomic) {
+  ServerConfig config;
+  config.normal_output_limit = {1000, 0, 0};
+  client_registry.setLimits(config);
+
+  ClientState client;
+  client.info = client_registry.add(-1, "exec:1");
+  std::string reply;
+  {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    executeCommand({"SET", "limit:exec", std::string(600, 'v')}, client,
+                   reply);
+    executeCommand({"MULTI"}, client, reply);
+    executeCommand({"GET", "limit:exec"}, client, reply);
+    executeCommand({"GET", "limit:exec"}, client, reply);
+    executeCommand({"GET", "limit:exec"}, client, reply);
+    executeCommand({"SET", "limit:after", "1"}, client, reply);
+    reply.clear();
+    executeCommand({"EXEC"}, client, reply);
+  }
+  EXPECT_TRUE(client.output_limit_reached);
+  // The third reply, queued after the limit was crossed, is dropped.
+  EXPECT_LT(reply.size(), 3 * 600u);
+
+  // The client is dropped, but the whole transaction was applied.
+  ClientState other;
+  std::string value;
+  {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    executeCommand({"GET", "limit:after"}, other, value);
+  }
+  EXPECT_EQ(value, "$1\r\n1\r\n");
+
+  releaseClientState(client);
+  client_registry.remove(client.info->id);
+  client_registry.setLimits(ServerConfig{});
+}
+
+TEST(ClientRegistryTest, HardOutputLimitClosesIOThreadClient) {
+  ServerConfig config;
+  config.normal_output_limit = {64 * 1024, 0, 0};
+  client_registry.setLimits(config);
+
+  {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    store.insert_or_assign("limit:io", StoreValue(std::string(10000, 'v')));
+  }
+
+  {
+    IOThreadServer server(1);
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    server.addClient(sv[0], client_registry.add(sv[0], "pipeline:1"));
+
+    // 100 pipelined GETs would queue ~1 MB of replies.
+    std::string get = "*2\r\n$3\r\nGET\r\n$8\r\nlimit:io\r\n";
+    std::string pipeline;
+    for (int i = 0; i < 100; ++i)
+      pipeline += get;
+    ASSERT_EQ(write(sv[1], pipeline.data(), pipeline.size()),
+              static_cast<ssize_t>(pipeline.size()));
+
+    size_t received = 0;
+    char buffer[16 * 1024];
+    ssize_t n;
+    while ((n = read(sv[1], buffer, sizeof(buffer))) > 0)
+      received += n;
+    EXPECT_EQ(n, 0); // closed by the server
+    EXPECT_LE(received, 64u * 1024);
+    close(sv[1]);
+  }
+  client_registry.setLimits(ServerConfig{});
+}
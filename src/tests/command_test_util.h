@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../include/handle_command.h"
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Runs one command under store_mutex, as the connection loop does, and
+// returns its reply.
+inline std::string run(ClientState &client,
+                       const std::vector<std::string> &parts) {
+  std::lock_guard<std::mutex> lock(store_mutex);
+  std::string reply;
+  executeCommand(parts, client, reply);
+  return reply;
+}
+
+// Base fixture for command tests: each test starts with an empty keyspace
+// and no WATCHed keys.
+class CommandTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    store.clear();
+    watched_keys.clear();
+  }
+};
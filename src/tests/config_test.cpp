@@ -0,0 +1,71 @@
+#include "../include/config.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+TEST(ConfigTest, Defaults) {
+  ServerConfig config;
+  EXPECT_EQ(config.port, 6379);
+  EXPECT_EQ(config.tcp_backlog, 511);
+  EXPECT_TRUE(config.tcp_nodelay);
+  EXPECT_TRUE(config.unixsocket.empty());
+}
+
+TEST(ConfigTest, ApplyOptions) {
+  ServerConfig config;
+  applyConfigOption(config, "PORT", {"7000"});
+  applyConfigOption(config, "bind", {"127.0.0.1", "::1"});
+  applyConfigOption(config, "unixsocketperm", {"770"});
+  applyConfigOption(config, "tcp-nodelay", {"no"});
+  EXPECT_EQ(config.port, 7000);
+  EXPECT_EQ(config.bind, (std::vector<std::string>{"127.0.0.1", "::1"}));
+  EXPECT_EQ(config.unixsocketperm, 0770u);
+  EXPECT_FALSE(config.tcp_nodelay);
+
+  EXPECT_THROW(applyConfigOption(config, "port", {"70000"}),
+               std::invalid_argument);
+  EXPECT_THROW(applyConfigOption(config, "tcp-backlog", {"12abc"}),
+               std::invalid_argument);
+  EXPECT_THROW(applyConfigOption(config, "tcp-nodelay", {"maybe"}),
+               std::invalid_argument);
+  EXPECT_THROW(applyConfigOption(config, "no-such-option", {"1"}),
+               std::invalid_argument);
+}
+
+TEST(ConfigTest, MemorySizes) {
+  EXPECT_EQ(parseMemorySize("100"), 100u);
+  EXPECT_EQ(parseMemorySize("2k"), 2000u);
+  EXPECT_EQ(parseMemorySize("64MB"), 64u * 1024 * 1024);
+  EXPECT_EQ(parseMemorySize("1gb"), 1024u * 1024 * 1024);
+
+  EXPECT_THROW(parseMemorySize("gb"), std::invalid_argument);
+  EXPECT_THROW(parseMemorySize("10tb"), std::invalid_argument);
+  EXPECT_THROW(parseMemorySize("1234567890123"), std::invalid_argument);
+  // 12 digits of gigabytes would wrap size_t rather than fail.
+  EXPECT_THROW(parseMemorySize("999999999999gb"), std::invalid_argument);
+}
+
+TEST(ConfigTest, FileThenCommandLine) {
+  std::string path = ::testing::TempDir() + "config_test.conf";
+  {
+    std::ofstream file(path);
+    file << "# sidecar settings\n"
+         << "port 6390\n"
+         << "\n"
+         << "unixsocket /tmp/redis.sock   # local clients\n"
+         << "tcp-backlog 1024\n";
+  }
+
+  std::string prog = "redis-server";
+  std::string port_flag = "--port";
+  std::string port_value = "6391";
+  char *argv[] = {prog.data(), path.data(), port_flag.data(),
+                  port_value.data()};
+  ServerConfig config = parseCommandLine(4, argv);
+  std::remove(path.c_str());
+
+  EXPECT_EQ(config.port, 6391);
+  EXPECT_EQ(config.unixsocket, "/tmp/redis.sock");
+  EXPECT_EQ(config.tcp_backlog, 1024);
+}
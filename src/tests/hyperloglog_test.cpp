@@ -0,0 +1,108 @@
+#include "../include/hyperloglog.h"
+#include "command_test_util.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+long long integerReply(const std::string &reply) {
+  return std::stoll(reply.substr(1));
+}
+
+class HyperLogLogTest : public CommandTest {};
+
+} // namespace
+
+TEST_F(HyperLogLogTest, EmptySketchIsSparse) {
+  std::string hll = hllCreate();
+  EXPECT_TRUE(isHyperLogLog(hll));
+  EXPECT_TRUE(hllIsSparse(hll));
+  EXPECT_EQ(hll.size(), kHllHeaderSize + 2); // a single XZERO opcode
+  EXPECT_EQ(hllCount(hll), 0u);
+
+  EXPECT_FALSE(isHyperLogLog(""));
+  EXPECT_FALSE(isHyperLogLog("HYLL"));
+  EXPECT_FALSE(isHyperLogLog(hll.substr(0, hll.size() - 1)));
+}
+
+TEST_F(HyperLogLogTest, SparseSmallCountsAreExact) {
+  std::string hll = hllCreate();
+  for (int i = 0; i < 100; ++i) {
+    hllAdd(hll, "user:" + std::to_string(i));
+  }
+  EXPECT_TRUE(hllIsSparse(hll));
+  EXPECT_TRUE(isHyperLogLog(hll));
+  EXPECT_NEAR(static_cast<double>(hllCount(hll)), 100, 2);
+  EXPECT_FALSE(hllAdd(hll, "user:5"));
+}
+
+TEST_F(HyperLogLogTest, PromotesToDenseAndStaysAccurate) {
+  std::string hll = hllCreate();
+  uint8_t registers[kHllRegisters] = {0};
+  const int kElements = 200000;
+  for (int i = 0; i < kElements; ++i) {
+    hllAdd(hll, "visitor:" + std::to_string(i));
+    if (i == 2000) {
+      // Long before this point the sparse body passed kHllSparseMaxBytes.
+      EXPECT_FALSE(hllIsSparse(hll));
+      EXPECT_EQ(hll.size(), kHllDenseSize);
+    }
+  }
+  ASSERT_TRUE(isHyperLogLog(hll));
+
+  // Standard error is 1.04 / sqrt(16384) = 0.81%; allow 3 sigma.
+  double estimate = static_cast<double>(hllCount(hll));
+  EXPECT_LT(std::abs(estimate - kElements) / kElements, 0.025);
+
+  hllMergeInto(hll, registers);
+  EXPECT_EQ(hllCountRegisters(registers), hllCount(hll));
+  EXPECT_EQ(hllFromRegisters(registers).substr(kHllHeaderSize),
+            hll.substr(kHllHeaderSize));
+}
+
+TEST_F(HyperLogLogTest, PfaddAndPfcount) {
+  ClientState client;
+  EXPECT_EQ(run(client, {"PFADD", "hll", "a", "b", "c"}), ":1\r\n");
+  EXPECT_EQ(run(client, {"PFADD", "hll", "a", "b"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"PFCOUNT", "hll"}), ":3\r\n");
+  EXPECT_EQ(run(client, {"PFADD", "empty"}), ":1\r\n");
+  EXPECT_EQ(run(client, {"PFCOUNT", "empty"}), ":0\r\n");
+  EXPECT_EQ(run(client, {"PFCOUNT", "missing"}), ":0\r\n");
+
+  run(client, {"SET", "plain", "value"});
+  EXPECT_EQ(run(client, {"PFADD", "plain", "a"}),
+            "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n");
+  EXPECT_EQ(run(client, {"PFCOUNT", "hll", "plain"}),
+            "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n");
+}
+
+TEST_F(HyperLogLogTest, PfmergeAndMultiKeyPfcount) {
+  ClientState client;
+  std::vector<std::string> a = {"PFADD", "a"};
+  std::vector<std::string> b = {"PFADD", "b"};
+  for (int i = 0; i < 5000; ++i) {
+    a.push_back("x" + std::to_string(i));
+    b.push_back("x" + std::to_string(i + 2500));
+  }
+  run(client, a);
+  run(client, b);
+
+  long long union_count = integerReply(run(client, {"PFCOUNT", "a", "b"}));
+  EXPECT_NEAR(union_count, 7500, 7500 * 0.025);
+
+  EXPECT_EQ(run(client, {"PFMERGE", "dest", "a", "b"}), "+OK\r\n");
+  EXPECT_EQ(integerReply(run(client, {"PFCOUNT", "dest"})), union_count);
+
+  // The destination is part of the union.
+  run(client, {"PFADD", "c", "y"});
+  EXPECT_EQ(run(client, {"PFMERGE", "c", "a"}), "+OK\r\n");
+  EXPECT_EQ(integerReply(run(client, {"PFCOUNT", "c"})),
+            integerReply(run(client, {"PFCOUNT", "a", "c"})));
+}
+
+TEST_F(HyperLogLogTest, SketchesAreStrings) {
+  ClientState client;
+  run(client, {"PFADD", "hll", "a"});
+  std::string dump = run(client, {"GET", "hll"});
+  EXPECT_EQ(dump.substr(dump.find("\r\n") + 2, 4), "HYLL");
+}
@@ -0,0 +1,97 @@
+#include "../include/io_threads.h"
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string readExactly(int fd, size_t bytes) {
+  std::string out;
+  char buffer[256];
+  while (out.size() < bytes) {
+    ssize_t n = read(fd, buffer, std::min(sizeof(buffer), bytes - out.size()));
+    if (n <= 0)
+      break;
+    out.append(buffer, n);
+  }
+  return out;
+}
+
+// Returns the test's end of a socket pair whose other end the server owns.
+int connectClient(IOThreadServer &server) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    return -1;
+  server.addClient(sv[0], client_registry.add(sv[0], "test:0"));
+  return sv[1];
+}
+
+} // namespace
+
+TEST(IOThreadServerTest, PipelinedCommands) {
+  IOThreadServer server(2);
+  int fd = connectClient(server);
+  ASSERT_GE(fd, 0);
+
+  std::string request = "*1\r\n$4\r\nPING\r\n"
+                        "*3\r\n$3\r\nSET\r\n$5\r\nio:k1\r\n$1\r\nv\r\n"
+                        "*2\r\n$3\r\nGET\r\n$5\r\nio:k1\r\n";
+  ASSERT_EQ(write(fd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+
+  std::string expected = "+PONG\r\n+OK\r\n$1\r\nv\r\n";
+  EXPECT_EQ(readExactly(fd, expected.size()), expected);
+  close(fd);
+}
+
+TEST(IOThreadServerTest, CommandSplitAcrossWrites) {
+  IOThreadServer server(1);
+  int fd = connectClient(server);
+  ASSERT_GE(fd, 0);
+
+  std::string first = "*2\r\n$4\r\nEC";
+  std::string second = "HO\r\n$2\r\nhi\r\n";
+  ASSERT_EQ(write(fd, first.data(), first.size()),
+            static_cast<ssize_t>(first.size()));
+  ASSERT_EQ(write(fd, second.data(), second.size()),
+            static_cast<ssize_t>(second.size()));
+
+  EXPECT_EQ(readExactly(fd, 8), "$2\r\nhi\r\n");
+  close(fd);
+}
+
+TEST(IOThreadServerTest, ClientsOnDifferentThreadsShareKeyspace) {
+  IOThreadServer server(2);
+  int writer = connectClient(server);
+  int reader = connectClient(server);
+  ASSERT_GE(writer, 0);
+  ASSERT_GE(reader, 0);
+
+  std::string set = "*3\r\n$3\r\nSET\r\n$5\r\nio:k2\r\n$2\r\nv2\r\n";
+  ASSERT_EQ(write(writer, set.data(), set.size()),
+            static_cast<ssize_t>(set.size()));
+  EXPECT_EQ(readExactly(writer, 5), "+OK\r\n");
+
+  std::string get = "*2\r\n$3\r\nGET\r\n$5\r\nio:k2\r\n";
+  ASSERT_EQ(write(reader, get.data(), get.size()),
+            static_cast<ssize_t>(get.size()));
+  EXPECT_EQ(readExactly(reader, 8), "$2\r\nv2\r\n");
+
+  close(writer);
+  close(reader);
+}
+
+TEST(IOThreadServerTest, ProtocolErrorRepliesAndCloses) {
+  IOThreadServer server(1);
+  int fd = connectClient(server);
+  ASSERT_GE(fd, 0);
+
+  // An inline command after a valid one: the valid one still runs.
+  std::string request = "*1\r\n$4\r\nPING\r\nPING\r\n";
+  ASSERT_EQ(write(fd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+
+  std::string expected = "+PONG\r\n-ERR Protocol error: invalid type 'P'\r\n";
+  EXPECT_EQ(readExactly(fd, expected.size() + 1), expected);
+  close(fd);
+}
@@ -0,0 +1,358 @@
+#include "../include/resp_parser.h"
+#include "../include/resp_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// The find()/stoi() tokenizer that the SIMD framing scan replaced, kept as
+// the oracle for equivalence. Only fed complete, well-formed streams: on
+// truncated input it can loop forever.
+std::vector<Token> referenceTokenizer(const std::string &input) {
+  std::vector<Token> tokens;
+  size_t pos = 0;
+  while (pos < input.size()) {
+    size_t start = pos;
+    char c = input[pos];
+    switch (c) {
+    case '+':
+    case '-':
+    case ':':
+    case ',': {
+      TokenType type = c == '+'   ? TokenType::STRING
+                       : c == '-' ? TokenType::ERROR
+                       : c == ':' ? TokenType::INTEGER
+                                  : TokenType::DOUBLE;
+      size_t end = input.find("\r\n", pos);
+      tokens.emplace_back(type, input.substr(pos + 1, end - (pos + 1)),
+                          end - start + 2);
+      pos = end + 2;
+      break;
+    }
+    case '_':
+      tokens.emplace_back(TokenType::NULLs, "", 3);
+      pos += 3;
+      break;
+    case '$': {
+      size_t end = input.find("\r\n", pos);
+      int len = std::stoi(input.substr(pos + 1, end - (pos + 1)));
+      pos = end + 2;
+      if (len == -1) {
+        tokens.emplace_back(TokenType::NULLs, "", end - start + 2);
+      } else {
+        if (input.size() < pos + len + 2 ||
+            input.substr(pos + len, 2) != "\r\n") {
+          throw std::runtime_error("Bulk string length mismatch");
+        }
+        tokens.emplace_back(TokenType::BULKSTRING, input.substr(pos, len),
+                            end - start + 2 + len + 2);
+        pos += len + 2;
+      }
+      break;
+    }
+    case '*': {
+      size_t end = input.find("\r\n", pos);
+      int num = std::stoi(input.substr(pos + 1, end - (pos + 1)));
+      pos = end + 2;
+      tokens.emplace_back(TokenType::ARRAY_BEGIN, "", end - start + 2, num);
+      break;
+    }
+    default:
+      throw std::runtime_error("Invalid RESP type");
+    }
+  }
+  return tokens;
+}
+
+// Random bytes biased towards '\r' and '\n' so payloads contain CRLFs.
+std::string randomPayload(std::mt19937 &rng, size_t max_len) {
+  std::uniform_int_distribution<size_t> len_dist(0, max_len);
+  std::uniform_int_distribution<int> byte_dist(0, 255);
+  std::string out(len_dist(rng), '\0');
+  for (auto &c : out) {
+    int b = byte_dist(rng);
+    c = b < 32 ? '\r' : b < 64 ? '\n' : static_cast<char>(b);
+  }
+  return out;
+}
+
+// Line payloads (simple strings, errors) must not contain '\r' or '\n'.
+std::string randomLine(std::mt19937 &rng) {
+  std::string out = randomPayload(rng, 12);
+  for (auto &c : out) {
+    if (c == '\r' || c == '\n')
+      c = 'x';
+  }
+  return out;
+}
+
+std::string randomFrame(std::mt19937 &rng) {
+  std::uniform_int_distribution<int> kind(0, 6);
+  switch (kind(rng)) {
+  case 0:
+    return "+" + randomLine(rng) + "\r\n";
+  case 1:
+    return "-" + randomLine(rng) + "\r\n";
+  case 2:
+    return ":" + std::to_string(static_cast<long long>(rng()) - (1LL << 31)) +
+           "\r\n";
+  case 3:
+    return "$-1\r\n";
+  case 4:
+    return "_\r\n";
+  default: {
+    std::uniform_int_distribution<int> argc(1, 6);
+    int n = argc(rng);
+    std::string out = "*" + std::to_string(n) + "\r\n";
+    for (int i = 0; i < n; ++i) {
+      std::string arg = randomPayload(rng, 80);
+      out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+  }
+  }
+}
+
+void expectSameTokens(const std::vector<Token> &a,
+                      const std::vector<Token> &b) {
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a[i].type, b[i].type);
+    EXPECT_EQ(a[i].value, b[i].value);
+    EXPECT_EQ(a[i].length, b[i].length);
+    EXPECT_EQ(a[i].count, b[i].count);
+  }
+}
+
+std::vector<ScanKernel> supportedKernels() {
+  std::vector<ScanKernel> kernels;
+  for (auto k : {ScanKernel::Scalar, ScanKernel::SSE2, ScanKernel::AVX2}) {
+    if (scanKernelSupported(k))
+      kernels.push_back(k);
+  }
+  return kernels;
+}
+
+} // namespace
+
+TEST(RespScanTest, KernelsAgree) {
+  std::mt19937 rng(1234);
+  for (int iter = 0; iter < 500; ++iter) {
+    std::string buffer = randomPayload(rng, 300);
+    std::vector<size_t> expected;
+    for (size_t i = 0; i + 1 < buffer.size(); ++i) {
+      if (buffer[i] == '\r' && buffer[i + 1] == '\n')
+        expected.push_back(i);
+    }
+    for (auto kernel : supportedKernels()) {
+      std::vector<size_t> positions;
+      findCRLF(buffer.data(), buffer.size(), positions, kernel);
+      EXPECT_EQ(positions, expected) << scanKernelName(kernel);
+    }
+  }
+}
+
+TEST(RespScanTest, ParseRespInteger) {
+  long long n = 0;
+  EXPECT_TRUE(parseRespInteger("123", "123" + 3, n));
+  EXPECT_EQ(n, 123);
+  EXPECT_TRUE(parseRespInteger("-1", "-1" + 2, n));
+  EXPECT_EQ(n, -1);
+  const char *max = "9223372036854775807";
+  EXPECT_TRUE(parseRespInteger(max, max + 19, n));
+  EXPECT_EQ(n, std::numeric_limits<long long>::max());
+  const char *min = "-9223372036854775808";
+  EXPECT_TRUE(parseRespInteger(min, min + 20, n));
+  EXPECT_EQ(n, std::numeric_limits<long long>::min());
+
+  const char *overflow = "9223372036854775808";
+  EXPECT_FALSE(parseRespInteger(overflow, overflow + 19, n));
+  EXPECT_FALSE(parseRespInteger("", "", n));
+  EXPECT_FALSE(parseRespInteger("-", "-" + 1, n));
+  EXPECT_FALSE(parseRespInteger("12a", "12a" + 3, n));
+  EXPECT_FALSE(parseRespInteger(" 1", " 1" + 2, n));
+}
+
+TEST(RespScanTest, FuzzTokenizerMatchesReference) {
+  std::mt19937 rng(42);
+  ScanKernel saved = activeScanKernel();
+  for (int iter = 0; iter < 300; ++iter) {
+    std::string stream;
+    std::uniform_int_distribution<int> frames(1, 20);
+    for (int i = frames(rng); i > 0; --i)
+      stream += randomFrame(rng);
+
+    auto expected = referenceTokenizer(stream);
+    for (auto kernel : supportedKernels()) {
+      setActiveScanKernel(kernel);
+      expectSameTokens(tokenizer(stream), expected);
+    }
+
+    // A cut anywhere must yield exactly the top-level frames that end at or
+    // before it, and report where the last of them ends. frame_ends[i] and
+    // frame_tokens[i] are the byte offset and token count after frame i.
+    std::vector<size_t> frame_ends = {0};
+    std::vector<size_t> frame_tokens = {0};
+    std::vector<long long> open_arrays;
+    size_t offset = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      offset += expected[i].length;
+      if (expected[i].type == TokenType::ARRAY_BEGIN && expected[i].count > 0) {
+        open_arrays.push_back(expected[i].count);
+        continue;
+      }
+      while (!open_arrays.empty() && --open_arrays.back() == 0)
+        open_arrays.pop_back();
+      if (open_arrays.empty()) {
+        frame_ends.push_back(offset);
+        frame_tokens.push_back(i + 1);
+      }
+    }
+    ASSERT_EQ(frame_ends.back(), stream.size());
+
+    // One arbitrary cut (usually inside a frame) and one frame boundary.
+    std::uniform_int_distribution<size_t> cut_dist(0, stream.size() - 1);
+    std::uniform_int_distribution<size_t> frame_dist(0, frame_ends.size() - 1);
+    for (size_t cut : {cut_dist(rng), frame_ends[frame_dist(rng)]}) {
+      std::string truncated = stream.substr(0, cut);
+      size_t frames =
+          std::upper_bound(frame_ends.begin(), frame_ends.end(), cut) -
+          frame_ends.begin() - 1;
+
+      std::vector<Token> partial;
+      size_t complete = 0;
+      ASSERT_NO_THROW(partial = tokenizer(truncated, &complete))
+          << "cut " << cut;
+      EXPECT_EQ(complete, frame_ends[frames]) << "cut " << cut;
+      expectSameTokens(partial,
+                       std::vector<Token>(expected.begin(),
+                                          expected.begin() +
+                                              frame_tokens[frames]));
+    }
+  }
+  setActiveScanKernel(saved);
+}
+
+TEST(RespScanTest, LargeBulkStringAcrossReadsIsLinear) {
+  // A 64 MB SET arriving in 16 KB reads, re-parsed after every read as the
+  // servers do. Scanning the whole buffer each time would touch ~128 GB;
+  // skipping the payload keeps each attempt to one block after the header.
+  const size_t kValueSize = 64 << 20;
+  const size_t kReadSize = 16 << 10;
+  std::string value(kValueSize, 'x');
+  std::string request = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$" +
+                        std::to_string(kValueSize) + "\r\n" + value + "\r\n";
+
+  std::string buffer;
+  std::vector<std::vector<std::string>> commands;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t off = 0; off < request.size(); off += kReadSize) {
+    buffer.append(request, off, kReadSize);
+    size_t consumed = parseCommands(buffer, commands);
+    if (buffer.size() < request.size()) {
+      ASSERT_EQ(consumed, 0u);
+      ASSERT_TRUE(commands.empty());
+    } else {
+      EXPECT_EQ(consumed, request.size());
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  ASSERT_EQ(commands.size(), 1u);
+  ASSERT_EQ(commands[0].size(), 3u);
+  EXPECT_EQ(commands[0][2].size(), kValueSize);
+  EXPECT_LT(elapsed.count(), 5.0);
+}
+
+TEST(RespScanTest, ParserCountsConsumedBytesPerValue) {
+  std::string first = "*2\r\n*1\r\n$1\r\na\r\n:5\r\n";
+  std::string second = "+OK\r\n";
+  RESPParser parser(first + second);
+  parser.parser();
+  EXPECT_EQ(parser.bytesConsumed(), first.size());
+  parser.parser();
+  EXPECT_EQ(parser.bytesConsumed(), first.size() + second.size());
+  EXPECT_FALSE(parser.hasMore());
+}
+
+TEST(RespScanTest, PipelinedCommandsParseInLinearTime) {
+  // One buffer holding ~100k pipelined SETs (about 4 MB), as an I/O thread
+  // sees it after a fast client's writes pile up. Re-summing token lengths
+  // per command made this take minutes.
+  const int kCommands = 100000;
+  std::string buffer;
+  for (int i = 0; i < kCommands; ++i) {
+    std::string key = "key:" + std::to_string(i);
+    buffer += "*3\r\n$3\r\nSET\r\n$" + std::to_string(key.size()) + "\r\n" +
+              key + "\r\n$5\r\nvalue\r\n";
+  }
+
+  std::vector<std::vector<std::string>> commands;
+  auto start = std::chrono::steady_clock::now();
+  size_t consumed = parseCommands(buffer, commands);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(consumed, buffer.size());
+  ASSERT_EQ(commands.size(), static_cast<size_t>(kCommands));
+  EXPECT_EQ(commands.back()[1], "key:" + std::to_string(kCommands - 1));
+  EXPECT_LT(elapsed.count(), 5.0);
+}
+
+TEST(RespScanTest, PipelinedCommandsAcrossReadsMakeProgress) {
+  // Variable-size pipelined SETs arriving in 16 KB reads. Reads rarely end
+  // on a command boundary; every one must still run the commands it
+  // completes, leaving at most one partial command buffered.
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<size_t> value_len(1, 3000);
+  std::string stream;
+  size_t largest = 0;
+  const int kCommands = 20000;
+  for (int i = 0; i < kCommands; ++i) {
+    std::string key = "key:" + std::to_string(i);
+    std::string value(value_len(rng), 'v');
+    std::string command = "*3\r\n$3\r\nSET\r\n$" +
+                          std::to_string(key.size()) + "\r\n" + key +
+                          "\r\n$" + std::to_string(value.size()) + "\r\n" +
+                          value + "\r\n";
+    largest = std::max(largest, command.size());
+    stream += command;
+  }
+
+  const size_t kReadSize = 16 << 10;
+  std::string buffer;
+  std::vector<std::vector<std::string>> commands;
+  for (size_t off = 0; off < stream.size(); off += kReadSize) {
+    buffer.append(stream, off, kReadSize);
+    buffer.erase(0, parseCommands(buffer, commands));
+    ASSERT_LT(buffer.size(), largest);
+  }
+  EXPECT_TRUE(buffer.empty());
+  ASSERT_EQ(commands.size(), static_cast<size_t>(kCommands));
+  EXPECT_EQ(commands.back()[1], "key:" + std::to_string(kCommands - 1));
+}
+
+TEST(RespScanTest, MalformedInputIsAProtocolError) {
+  std::string ping = "*1\r\n$4\r\nPING\r\n";
+  for (std::string junk : std::vector<std::string>{
+           "PING\r\n", "$4\r\nPING\r\n", "*1\r\n$x\r\nPING\r\n",
+           "*1\r\n$2\r\nPING\r\n", "*1\r\n:1\r\n", "*1\r\n*1\r\n$1\r\na\r\n",
+           "*1\r\n$" + std::string(70 * 1024, '1')}) {
+    std::vector<std::vector<std::string>> commands;
+    EXPECT_THROW(parseCommands(ping + junk, commands), ProtocolError)
+        << junk.substr(0, 16);
+    // The commands before the malformed frame are still returned.
+    ASSERT_EQ(commands.size(), 1u);
+    EXPECT_EQ(commands[0][0], "PING");
+  }
+
+  // Incomplete is not malformed.
+  std::vector<std::vector<std::string>> commands;
+  EXPECT_EQ(parseCommands(ping + "*1\r\n$4\r\nPI", commands), ping.size());
+  EXPECT_EQ(commands.size(), 1u);
+}
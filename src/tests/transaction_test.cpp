@@ -0,0 +1,64 @@
+#include "command_test_util.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+class TransactionTest : public CommandTest {};
+
+} // namespace
+
+TEST_F(TransactionTest, ExecRunsQueuedCommands) {
+  ClientState client;
+  EXPECT_EQ(run(client, {"MULTI"}), "+OK\r\n");
+  EXPECT_EQ(run(client, {"SET", "a", "1"}), "+QUEUED\r\n");
+  EXPECT_EQ(run(client, {"GET", "a"}), "+QUEUED\r\n");
+  EXPECT_EQ(run(client, {"EXEC"}), "*2\r\n+OK\r\n$1\r\n1\r\n");
+  EXPECT_FALSE(client.in_multi);
+}
+
+TEST_F(TransactionTest, DiscardDropsQueue) {
+  ClientState client;
+  run(client, {"MULTI"});
+  run(client, {"SET", "a", "1"});
+  EXPECT_EQ(run(client, {"DISCARD"}), "+OK\r\n");
+  EXPECT_EQ(run(client, {"GET", "a"}), "$-1\r\n");
+  EXPECT_EQ(run(client, {"EXEC"}), "-ERR EXEC without MULTI\r\n");
+}
+
+TEST_F(TransactionTest, QueueErrorAbortsExec) {
+  ClientState client;
+  run(client, {"MULTI"});
+  EXPECT_EQ(run(client, {"NOPE"}), "-ERR unknown command 'NOPE'\r\n");
+  EXPECT_EQ(run(client, {"EXEC"}),
+            "-EXECABORT Transaction discarded because of previous errors.\r\n");
+}
+
+TEST_F(TransactionTest, WatchedKeyWriteAbortsExec) {
+  ClientState watcher;
+  ClientState writer;
+  EXPECT_EQ(run(watcher, {"WATCH", "k"}), "+OK\r\n");
+  run(writer, {"SET", "k", "other"});
+  run(watcher, {"MULTI"});
+  run(watcher, {"SET", "k", "mine"});
+  EXPECT_EQ(run(watcher, {"EXEC"}), "*-1\r\n");
+  EXPECT_EQ(run(writer, {"GET", "k"}), "$5\r\nother\r\n");
+  EXPECT_TRUE(watched_keys.empty());
+}
+
+TEST_F(TransactionTest, UnrelatedWriteDoesNotAbortExec) {
+  ClientState watcher;
+  ClientState writer;
+  run(watcher, {"WATCH", "k"});
+  run(writer, {"SET", "unrelated", "x"});
+  run(watcher, {"MULTI"});
+  run(watcher, {"SET", "k", "mine"});
+  EXPECT_EQ(run(watcher, {"EXEC"}), "*1\r\n+OK\r\n");
+}
+
+TEST_F(TransactionTest, ReleaseDropsWatches) {
+  ClientState client;
+  run(client, {"WATCH", "a", "b"});
+  EXPECT_EQ(watched_keys.size(), 2u);
+  releaseClientState(client);
+  EXPECT_TRUE(watched_keys.empty());
+}
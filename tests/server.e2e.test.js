@@ -37,3 +37,12 @@ test("ECHO returns the same message", async () => {
   const res = await tester.client.echo(msg);
   expect(res).toBe(msg);
 });
+
+test("MULTI/EXEC runs queued commands atomically", async () => {
+  const res = await tester.client
+    .multi()
+    .set("tx_key", "tx_value")
+    .get("tx_key")
+    .exec();
+  expect(res).toEqual(["OK", "tx_value"]);
+});